@@ -2,9 +2,13 @@
 
 #include <array>
 #include <cstring>
+#include <limits>
 #include <memory>
+#include <new>
+#include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "rlbox_app_pointer.hpp"
 #include "rlbox_conversion.hpp"
@@ -17,6 +21,7 @@
 #include "rlbox_type_traits.hpp"
 #include "rlbox_types.hpp"
 #include "rlbox_unwrap.hpp"
+#include "rlbox_verify_arena.hpp"
 #include "rlbox_wrapper_traits.hpp"
 
 namespace rlbox {
@@ -530,7 +535,9 @@ public:
           // Else, for tainted_volatile, this will allow a
           // time-of-check-time-of-use attack
           auto val_copy = std::make_unique<T_Deref>();
-          *val_copy = *val;
+          // Read through the tainted_volatile, as the value may have a
+          // different representation in the sandbox
+          *val_copy = (*impl()).get_raw_value();
           return verifier(std::move(val_copy));
         }
       }
@@ -561,6 +568,55 @@ public:
     }
   }
 
+  /**
+   * @brief Copy the tainted value a pointer points to from sandbox into an
+   * arena and verify it. Unlike copy_and_verify, this doesn't allocate on the
+   * heap.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param arena The arena to copy to. The copy lives until the arena is
+   * reset.
+   * @tparam T_Func the type of the verifier. If the tainted type is ``int*``
+   * then ``T_Func = T_Ret(*)(int*)``, and if it is a pointer to a struct
+   * ``Foo*`` then ``T_Func = T_Ret(*)(tainted<Foo, T_Sbx>*)``. The verifier is
+   * passed null if the tainted pointer is null.
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify(T_Func verifier, verify_arena& arena) const
+  {
+    using T_Deref = std::remove_cv_t<std::remove_pointer_t<T>>;
+
+    static_assert(detail::is_one_level_ptr_v<T> && !std::is_void_v<T_Deref> &&
+                    !detail::is_func_ptr_v<T>,
+                  "copy_and_verify with an arena is only supported for "
+                  "pointers to data that is not a pointer");
+
+    if constexpr (std::is_class_v<T_Deref>) {
+      using T_Copy = tainted<T_Deref, T_Sbx>;
+      static_assert(std::is_trivially_destructible_v<T_Copy>,
+                    "copy_and_verify with an arena requires structs that are "
+                    "trivially destructible");
+
+      if (impl().get_raw_value() == nullptr) {
+        return verifier(static_cast<T_Copy*>(nullptr));
+      }
+      auto val_copy =
+        new (arena.allocate(sizeof(T_Copy), alignof(T_Copy))) T_Copy(*impl());
+      return verifier(val_copy);
+    } else {
+      auto val = impl().get_raw_value();
+      if (val == nullptr) {
+        return verifier(static_cast<T_Deref*>(nullptr));
+      }
+      // Copy so that verification is not subject to a time-of-check-time-of-use
+      // attack, as in copy_and_verify
+      auto val_copy = arena.allocate_array<T_Deref>(1);
+      *val_copy = (*impl()).get_raw_value();
+      return verifier(val_copy);
+    }
+  }
+
 private:
   using T_CopyAndVerifyRangeEl =
     detail::valid_array_el_t<std::remove_cv_t<std::remove_pointer_t<T>>>;
@@ -582,12 +638,33 @@ private:
       return nullptr;
     }
 
-    detail::check_sandbox_pointer_range_is_contained<T_Sbx>(
-      start, count * sizeof(T_CopyAndVerifyRangeEl));
+    // The elements may be smaller in sandbox memory
+    using T_SbxEl = typename rlbox_sandbox<T_Sbx>::
+      template convert_to_sandbox_equivalent_nonclass_t<T_CopyAndVerifyRangeEl>;
+    constexpr size_t el_size = sizeof(T_SbxEl);
+    detail::dynamic_check(count <= std::numeric_limits<size_t>::max() / el_size,
+                          "Range passed to copy_and_verify_range is too large");
+    detail::check_sandbox_pointer_range_is_contained<T_Sbx>(start,
+                                                            count * el_size);
 
     return start;
   }
 
+  // Copies count elements from start, which was returned by
+  // verify_range_helper, to dest
+  template<typename T2 = T>
+  inline void copy_range_helper(T_CopyAndVerifyRangeEl* dest,
+                                const void* start,
+                                std::size_t count) const
+  {
+    // The whole range has been bounds checked, so convert it in bulk rather
+    // than indexing each element
+    using T_SbxEl = typename rlbox_sandbox<T_Sbx>::
+      template convert_to_sandbox_equivalent_nonclass_t<T_CopyAndVerifyRangeEl>;
+    detail::convert_range_fundamental(
+      dest, static_cast<const T_SbxEl*>(start), count);
+  }
+
   template<typename T2 = T>
   inline std::unique_ptr<T_CopyAndVerifyRangeEl[]> copy_and_verify_range_helper(
     std::size_t count) const
@@ -597,54 +674,22 @@ private:
       return nullptr;
     }
 
-    auto target = std::make_unique<T_CopyAndVerifyRangeEl[]>(count);
-
-    for (size_t i = 0; i < count; i++) {
-      auto p_src_i_tainted = &(impl()[i]);
-      auto p_src_i = p_src_i_tainted.get_raw_value();
-      detail::convert_type_fundamental_or_array(target[i], *p_src_i);
-    }
-
+    // Not value initialized, as every element is overwritten below
+    std::unique_ptr<T_CopyAndVerifyRangeEl[]> target(
+      new T_CopyAndVerifyRangeEl[count]);
+    copy_range_helper(target.get(), start, count);
     return target;
   }
 
-public:
-  /**
-   * @brief Copy a range of tainted values from sandbox and verify them.
-   *
-   * @param verifier Function used to verify the copied value.
-   * @param count Number of elements to copy.
-   * @tparam T_Func the type of the verifier. If the tainted type is ``int*``
-   * then ``T_Func = T_Ret(*)(unique_ptr<int[]>)``.
-   * @return Whatever the verifier function returns.
-   */
-  template<typename T_Func>
-  inline auto copy_and_verify_range(T_Func verifier, std::size_t count) const
-  {
-    static_assert(std::is_pointer_v<T>,
-                  "Can only call copy_and_verify_range on pointers");
-
-    static_assert(
-      detail::is_fundamental_or_enum_v<T_CopyAndVerifyRangeEl>,
-      "copy_and_verify_range is only safe for ranges of "
-      "fundamental or enum types. For other types, call "
-      "copy_and_verify on each element --- a[i].copy_and_verify(...)");
-
-    std::unique_ptr<T_CopyAndVerifyRangeEl[]> target =
-      copy_and_verify_range_helper(count);
-    return verifier(std::move(target));
-  }
+  template<typename T_Alloc>
+  using T_CopyAndVerifyRangeAlloc = typename std::allocator_traits<
+    T_Alloc>::template rebind_alloc<T_CopyAndVerifyRangeEl>;
 
-  /**
-   * @brief Copy a tainted string from sandbox and verify it.
-   *
-   * @param verifier Function used to verify the copied value.
-   * @tparam T_Func the type of the verifier either
-   * ``T_Ret(*)(unique_ptr<char[]>)`` or ``T_Ret(*)(std::string)``
-   * @return Whatever the verifier function returns.
-   */
+  // The copy_and_verify_string overloads, where sandbox is the sandbox the
+  // string is in, or null if it isn't known
   template<typename T_Func>
-  inline auto copy_and_verify_string(T_Func verifier) const
+  inline auto copy_and_verify_string_helper(rlbox_sandbox<T_Sbx>* sandbox,
+                                            T_Func verifier) const
   {
     static_assert(std::is_pointer_v<T>,
                   "Can only call copy_and_verify_string on pointers");
@@ -664,11 +709,7 @@ public:
         return verifier(nullptr);
       }
 
-      // it is safe to run strlen on a tainted<string> as worst case, the string
-      // does not have a null and we try to copy all the memory out of the
-      // sandbox however, copy_and_verify_range ensures that we never copy
-      // memory outsider the range
-      auto str_len = std::strlen(start) + 1;
+      auto str_len = detail::get_sandbox_string_length(sandbox, start) + 1;
       std::unique_ptr<T_CopyAndVerifyRangeEl[]> target =
         copy_and_verify_range_helper(str_len);
 
@@ -684,11 +725,7 @@ public:
         return verifier(param);
       }
 
-      // it is safe to run strlen on a tainted<string> as worst case, the string
-      // does not have a null and we try to copy all the memory out of the
-      // sandbox however, copy_and_verify_range ensures that we never copy
-      // memory outsider the range
-      auto str_len = std::strlen(start) + 1;
+      auto str_len = detail::get_sandbox_string_length(sandbox, start) + 1;
 
       const char* checked_start = (const char*)verify_range_helper(str_len);
       if (checked_start == nullptr) {
@@ -709,6 +746,362 @@ public:
     }
   }
 
+  template<typename T_Func, typename T_Alloc>
+  inline auto copy_and_verify_string_helper(rlbox_sandbox<T_Sbx>* sandbox,
+                                            T_Func verifier,
+                                            const T_Alloc& alloc) const
+  {
+    static_assert(std::is_pointer_v<T>,
+                  "Can only call copy_and_verify_string on pointers");
+
+    static_assert(std::is_same_v<char, T_CopyAndVerifyRangeEl>,
+                  "copy_and_verify_string only allows char*");
+
+    using T_String = std::basic_string<char,
+                                       std::char_traits<char>,
+                                       T_CopyAndVerifyRangeAlloc<T_Alloc>>;
+    T_CopyAndVerifyRangeAlloc<T_Alloc> str_alloc(alloc);
+
+    auto start = impl().get_raw_value();
+    if (start == nullptr) {
+      return verifier(T_String(str_alloc));
+    }
+
+    auto str_len = detail::get_sandbox_string_length(sandbox, start) + 1;
+    auto checked_start =
+      static_cast<const char*>(verify_range_helper(str_len));
+    return verifier(T_String(checked_start, str_len - 1, str_alloc));
+  }
+
+  template<typename T_Func>
+  inline auto copy_and_verify_string_into_helper(
+    rlbox_sandbox<T_Sbx>* sandbox,
+    T_Func verifier,
+    char* dest,
+    std::size_t capacity) const
+  {
+    static_assert(std::is_pointer_v<T>,
+                  "Can only call copy_and_verify_string_into on pointers");
+
+    static_assert(std::is_same_v<char, T_CopyAndVerifyRangeEl>,
+                  "copy_and_verify_string_into only allows char*");
+
+    auto start = impl().get_raw_value();
+    if (start == nullptr || capacity == 0) {
+      return verifier(static_cast<char*>(nullptr));
+    }
+
+    auto str_len = detail::get_sandbox_string_length(sandbox, start, capacity);
+    if (str_len == capacity) {
+      return verifier(static_cast<char*>(nullptr));
+    }
+
+    auto checked_start =
+      static_cast<const char*>(verify_range_helper(str_len + 1));
+    detail::dynamic_check(dest != nullptr,
+                          "copy_and_verify_string_into given a null buffer");
+    std::memcpy(dest, checked_start, str_len);
+    // ensure the string has a trailing null
+    dest[str_len] = '\0';
+    return verifier(dest);
+  }
+
+  template<typename T_Func>
+  inline auto copy_and_verify_string_helper(rlbox_sandbox<T_Sbx>* sandbox,
+                                            T_Func verifier,
+                                            verify_arena& arena) const
+  {
+    static_assert(std::is_pointer_v<T>,
+                  "Can only call copy_and_verify_string on pointers");
+
+    static_assert(std::is_same_v<char, T_CopyAndVerifyRangeEl>,
+                  "copy_and_verify_string only allows char*");
+
+    auto start = impl().get_raw_value();
+    if (start == nullptr) {
+      return verifier(static_cast<char*>(nullptr));
+    }
+
+    auto str_len = detail::get_sandbox_string_length(sandbox, start) + 1;
+    auto checked_start =
+      static_cast<const char*>(verify_range_helper(str_len));
+    auto target = arena.allocate_array<char>(str_len);
+    std::memcpy(target, checked_start, str_len - 1);
+    // ensure the string has a trailing null
+    target[str_len - 1] = '\0';
+    return verifier(target);
+  }
+
+public:
+  /**
+   * @brief Copy a range of tainted values from sandbox and verify them.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param count Number of elements to copy.
+   * @tparam T_Func the type of the verifier. If the tainted type is ``int*``
+   * then ``T_Func = T_Ret(*)(unique_ptr<int[]>)``.
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_range(T_Func verifier, std::size_t count) const
+  {
+    static_assert(std::is_pointer_v<T>,
+                  "Can only call copy_and_verify_range on pointers");
+
+    static_assert(
+      detail::is_fundamental_or_enum_v<T_CopyAndVerifyRangeEl>,
+      "copy_and_verify_range is only safe for ranges of "
+      "fundamental or enum types. For other types, call "
+      "copy_and_verify on each element --- a[i].copy_and_verify(...)");
+
+    std::unique_ptr<T_CopyAndVerifyRangeEl[]> target =
+      copy_and_verify_range_helper(count);
+    return verifier(std::move(target));
+  }
+
+  /**
+   * @brief Copy a tainted string from sandbox and verify it.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @tparam T_Func the type of the verifier either
+   * ``T_Ret(*)(unique_ptr<char[]>)`` or ``T_Ret(*)(std::string)``
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_string(T_Func verifier) const
+  {
+    return copy_and_verify_string_helper(nullptr, verifier);
+  }
+
+  /**
+   * @brief Like copy_and_verify_string(verifier), but the string is scanned up
+   * to the end of the given sandbox's memory, which avoids looking up the
+   * sandbox the string is in.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_string(rlbox_sandbox<T_Sbx>& sandbox,
+                                     T_Func verifier) const
+  {
+    return copy_and_verify_string_helper(&sandbox, verifier);
+  }
+
+  /**
+   * @brief Copy a range of tainted values from sandbox into a vector that uses
+   * the given allocator, and verify them.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param count Number of elements to copy.
+   * @param alloc Allocator for the vector, which is rebound to the element
+   * type.
+   * @tparam T_Func the type of the verifier. If the tainted type is ``int*``
+   * then ``T_Func = T_Ret(*)(std::vector<int, T_Alloc>)``. The vector is empty
+   * if the tainted pointer is null.
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func, typename T_Alloc>
+  inline auto copy_and_verify_range(T_Func verifier,
+                                    std::size_t count,
+                                    const T_Alloc& alloc) const
+  {
+    static_assert(std::is_pointer_v<T>,
+                  "Can only call copy_and_verify_range on pointers");
+
+    static_assert(
+      detail::is_fundamental_or_enum_v<T_CopyAndVerifyRangeEl>,
+      "copy_and_verify_range is only safe for ranges of "
+      "fundamental or enum types. For other types, call "
+      "copy_and_verify on each element --- a[i].copy_and_verify(...)");
+
+    static_assert(!std::is_same_v<T_CopyAndVerifyRangeEl, bool>,
+                  "copy_and_verify_range with an allocator does not support "
+                  "ranges of bool");
+
+    T_CopyAndVerifyRangeAlloc<T_Alloc> vec_alloc(alloc);
+    std::vector<T_CopyAndVerifyRangeEl, T_CopyAndVerifyRangeAlloc<T_Alloc>>
+      target(vec_alloc);
+    const void* start = verify_range_helper(count);
+    if (start != nullptr) {
+      target.resize(count);
+      copy_range_helper(target.data(), start, count);
+    }
+    return verifier(std::move(target));
+  }
+
+  /**
+   * @brief Copy a range of tainted values from sandbox into a buffer provided
+   * by the caller, and verify them. Unlike copy_and_verify_range, this doesn't
+   * allocate.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param dest The buffer to copy to, which must have room for count
+   * elements.
+   * @param count Number of elements to copy.
+   * @tparam T_Func the type of the verifier. If the tainted type is ``int*``
+   * then ``T_Func = T_Ret(*)(int*)``. The verifier is passed dest, or null if
+   * the tainted pointer is null.
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_range_into(T_Func verifier,
+                                         T_CopyAndVerifyRangeEl* dest,
+                                         std::size_t count) const
+  {
+    static_assert(std::is_pointer_v<T>,
+                  "Can only call copy_and_verify_range_into on pointers");
+
+    static_assert(
+      detail::is_fundamental_or_enum_v<T_CopyAndVerifyRangeEl>,
+      "copy_and_verify_range_into is only safe for ranges of "
+      "fundamental or enum types. For other types, call "
+      "copy_and_verify on each element --- a[i].copy_and_verify(...)");
+
+    const void* start = verify_range_helper(count);
+    if (start == nullptr) {
+      return verifier(static_cast<T_CopyAndVerifyRangeEl*>(nullptr));
+    }
+    detail::dynamic_check(dest != nullptr,
+                          "copy_and_verify_range_into given a null buffer");
+    copy_range_helper(dest, start, count);
+    return verifier(dest);
+  }
+
+  /**
+   * @brief Copy a tainted string from sandbox into a string that uses the
+   * given allocator, and verify it.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param alloc Allocator for the string, which is rebound to char.
+   * @tparam T_Func the type of the verifier,
+   * ``T_Ret(*)(std::basic_string<char, std::char_traits<char>, T_Alloc>)``
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func, typename T_Alloc>
+  inline auto copy_and_verify_string(T_Func verifier,
+                                     const T_Alloc& alloc) const
+  {
+    return copy_and_verify_string_helper(nullptr, verifier, alloc);
+  }
+
+  /**
+   * @brief Like copy_and_verify_string(verifier, alloc), but the string is
+   * scanned up to the end of the given sandbox's memory, which avoids looking
+   * up the sandbox the string is in.
+   */
+  template<typename T_Func, typename T_Alloc>
+  inline auto copy_and_verify_string(rlbox_sandbox<T_Sbx>& sandbox,
+                                     T_Func verifier,
+                                     const T_Alloc& alloc) const
+  {
+    return copy_and_verify_string_helper(&sandbox, verifier, alloc);
+  }
+
+  /**
+   * @brief Copy a tainted string from sandbox into a buffer provided by the
+   * caller, and verify it. Unlike copy_and_verify_string, this doesn't
+   * allocate, and the string is only scanned as far as the buffer can hold.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param dest The buffer to copy to.
+   * @param capacity The size of dest in bytes, including room for the
+   * terminating null.
+   * @tparam T_Func the type of the verifier, ``T_Ret(*)(char*)``. The verifier
+   * is passed dest holding the null terminated string, or null if the tainted
+   * pointer is null or the string doesn't fit in dest.
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_string_into(T_Func verifier,
+                                          char* dest,
+                                          std::size_t capacity) const
+  {
+    return copy_and_verify_string_into_helper(
+      nullptr, verifier, dest, capacity);
+  }
+
+  /**
+   * @brief Like copy_and_verify_string_into(verifier, dest, capacity), but the
+   * string is scanned up to the end of the given sandbox's memory, which
+   * avoids looking up the sandbox the string is in.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_string_into(rlbox_sandbox<T_Sbx>& sandbox,
+                                          T_Func verifier,
+                                          char* dest,
+                                          std::size_t capacity) const
+  {
+    return copy_and_verify_string_into_helper(
+      &sandbox, verifier, dest, capacity);
+  }
+
+  /**
+   * @brief Copy a range of tainted values from sandbox into an arena and
+   * verify them. Unlike copy_and_verify_range, this doesn't allocate on the
+   * heap once the arena has grown.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param count Number of elements to copy.
+   * @param arena The arena to copy to. The copy lives until the arena is
+   * reset.
+   * @tparam T_Func the type of the verifier. If the tainted type is ``int*``
+   * then ``T_Func = T_Ret(*)(int*)``. The verifier is passed null if the
+   * tainted pointer is null.
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_range(T_Func verifier,
+                                    std::size_t count,
+                                    verify_arena& arena) const
+  {
+    static_assert(std::is_pointer_v<T>,
+                  "Can only call copy_and_verify_range on pointers");
+
+    static_assert(
+      detail::is_fundamental_or_enum_v<T_CopyAndVerifyRangeEl>,
+      "copy_and_verify_range is only safe for ranges of "
+      "fundamental or enum types. For other types, call "
+      "copy_and_verify on each element --- a[i].copy_and_verify(...)");
+
+    const void* start = verify_range_helper(count);
+    if (start == nullptr) {
+      return verifier(static_cast<T_CopyAndVerifyRangeEl*>(nullptr));
+    }
+    auto target = arena.allocate_array<T_CopyAndVerifyRangeEl>(count);
+    copy_range_helper(target, start, count);
+    return verifier(target);
+  }
+
+  /**
+   * @brief Copy a tainted string from sandbox into an arena and verify it.
+   * Unlike copy_and_verify_string, this doesn't allocate on the heap once the
+   * arena has grown.
+   *
+   * @param verifier Function used to verify the copied value.
+   * @param arena The arena to copy to. The copy lives until the arena is
+   * reset.
+   * @tparam T_Func the type of the verifier, ``T_Ret(*)(char*)``. The verifier
+   * is passed the null terminated string, or null if the tainted pointer is
+   * null.
+   * @return Whatever the verifier function returns.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_string(T_Func verifier, verify_arena& arena) const
+  {
+    return copy_and_verify_string_helper(nullptr, verifier, arena);
+  }
+
+  /**
+   * @brief Like copy_and_verify_string(verifier, arena), but the string is
+   * scanned up to the end of the given sandbox's memory, which avoids looking
+   * up the sandbox the string is in.
+   */
+  template<typename T_Func>
+  inline auto copy_and_verify_string(rlbox_sandbox<T_Sbx>& sandbox,
+                                     T_Func verifier,
+                                     verify_arena& arena) const
+  {
+    return copy_and_verify_string_helper(&sandbox, verifier, arena);
+  }
+
   /**
    * @brief Copy a tainted pointer from sandbox and verify the address.
    *
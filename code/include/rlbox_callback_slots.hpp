@@ -0,0 +1,132 @@
+#pragma once
+// IWYU pragma: private, include "rlbox.hpp"
+// IWYU pragma: friend "rlbox_.*\.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+#include "rlbox_pointer_set.hpp"
+
+namespace rlbox::detail {
+
+/**
+ * @brief The callback table of a sandbox plugin that dispatches callbacks
+ * through a fixed set of compile-time generated trampolines, where trampoline
+ * i calls the callback in slot i.
+ *
+ * Free slots are kept in a stack and registered keys are hashed to their
+ * slots in a fixed open addressing table that is never more than half full,
+ * so registering and unregistering a callback is O(1) regardless of the
+ * number of slots and never allocates. Callers must serialize calls to
+ * allocate and release.
+ *
+ * Trampolines read slots without locks, as reading a slot only loads from
+ * it. Each slot has a sequence number that is odd while the slot is being
+ * written, and a read retries if the sequence number changed, so a read never
+ * sees the key of one callback with the function of another. Slots are
+ * never freed, so a trampoline racing with unregistration either sees the
+ * callback or an empty slot.
+ *
+ * @tparam N The number of slots.
+ */
+template<uint32_t N>
+class callback_slots
+{
+  struct slot
+  {
+    std::atomic<uint32_t> sequence{ 0 };
+    std::atomic<void*> key{ nullptr };
+    std::atomic<void*> callback{ nullptr };
+  };
+
+  slot slots[N];
+  // Slots released by release, which are reused first
+  uint32_t free_stack[N]{};
+  uint32_t free_count = 0;
+  // Slots below this have been handed out at least once
+  uint32_t used_count = 0;
+
+  // Registered keys and their slots
+  fixed_pointer_map<uint32_t, N> key_slots;
+
+  inline void write(uint32_t index, void* key, void* callback)
+  {
+    auto& curr = slots[index];
+    uint32_t seq = curr.sequence.load(std::memory_order_relaxed);
+    curr.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    curr.key.store(key, std::memory_order_relaxed);
+    curr.callback.store(callback, std::memory_order_relaxed);
+    curr.sequence.store(seq + 2, std::memory_order_release);
+  }
+
+public:
+  static constexpr uint32_t capacity = N;
+
+  struct entry
+  {
+    void* key;
+    void* callback;
+  };
+
+  /**
+   * @brief Store a callback in a free slot.
+   *
+   * @return The slot, or capacity if every slot is in use.
+   */
+  inline uint32_t allocate(void* key, void* callback)
+  {
+    uint32_t slot;
+    if (free_count > 0) {
+      free_count--;
+      slot = free_stack[free_count];
+    } else if (used_count < N) {
+      slot = used_count;
+      used_count++;
+    } else {
+      return capacity;
+    }
+
+    write(slot, key, callback);
+    key_slots.insert(key, slot);
+    return slot;
+  }
+
+  /**
+   * @brief Free the slot of the callback registered with the given key. Does
+   * nothing if the key isn't registered.
+   */
+  inline void release(void* key)
+  {
+    uint32_t slot;
+    if (!key_slots.erase(key, slot)) {
+      return;
+    }
+
+    write(slot, nullptr, nullptr);
+    free_stack[free_count] = slot;
+    free_count++;
+  }
+
+  /**
+   * @brief Read the callback in a slot. This is safe to call concurrently
+   * with allocate and release.
+   */
+  inline entry load(uint32_t index) const
+  {
+    auto& curr = slots[index];
+    while (true) {
+      uint32_t seq = curr.sequence.load(std::memory_order_acquire);
+      if ((seq & 1) == 0) {
+        entry ret{ curr.key.load(std::memory_order_relaxed),
+                   curr.callback.load(std::memory_order_relaxed) };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (curr.sequence.load(std::memory_order_relaxed) == seq) {
+          return ret;
+        }
+      }
+    }
+  }
+};
+
+}
@@ -3,6 +3,7 @@
 // IWYU pragma: friend "rlbox_.*\.hpp"
 
 #include <array>
+#include <cstddef>
 #include <cstring>
 #include <limits>
 #include <type_traits>
@@ -13,6 +14,46 @@
 
 namespace rlbox::detail {
 
+// Whether every value of the integer type T_From is a value of T_To
+template<typename T_To, typename T_From>
+constexpr bool is_integer_conversion_lossless_v =
+  (std::is_signed_v<T_To> == std::is_signed_v<T_From> &&
+   sizeof(T_To) >= sizeof(T_From)) ||
+  (std::is_signed_v<T_To> && std::is_unsigned_v<T_From> &&
+   sizeof(T_To) > sizeof(T_From));
+
+// Whether the integer from is a value of the integer type T_To
+template<typename T_To, typename T_From>
+inline constexpr bool fits_in_integer(T_From from)
+{
+  using namespace std;
+
+  if constexpr (is_integer_conversion_lossless_v<T_To, T_From>) {
+    RLBOX_UNUSED(from);
+    return true;
+  } else if constexpr (is_unsigned_v<T_To> && is_unsigned_v<T_From>) {
+    // Eg: uint32_t from uint64_t
+    return from <= numeric_limits<T_To>::max();
+  } else if constexpr (is_signed_v<T_To> && is_signed_v<T_From>) {
+    // Eg: int32_t from int64_t
+    return from >= numeric_limits<T_To>::min() &&
+           from <= numeric_limits<T_To>::max();
+  } else if constexpr (is_unsigned_v<T_To> && is_signed_v<T_From>) {
+    if constexpr (sizeof(T_To) < sizeof(T_From)) {
+      // Eg: uint32_t from int64_t
+      auto to_max = numeric_limits<T_To>::max();
+      return from >= 0 && from <= static_cast<T_From>(to_max);
+    } else {
+      // Eg: uint32_t from int32_t, uint64_t from int32_t
+      return from >= 0;
+    }
+  } else {
+    // Eg: int32_t from uint32_t, int32_t from uint64_t
+    auto to_max = numeric_limits<T_To>::max();
+    return from <= static_cast<T_From>(to_max);
+  }
+}
+
 template<typename T_To, typename T_From>
 inline constexpr void convert_type_fundamental(T_To& to,
                                                const volatile T_From& from)
@@ -46,42 +87,13 @@ inline constexpr void convert_type_fundamental(T_To& to,
   {
     static_assert(is_integral_v<T_To> && is_integral_v<T_From>);
 
-    const char* err_msg =
-      "Over/Underflow when converting between integer types";
-
-    // Some branches don't use the param
-    RLBOX_UNUSED(err_msg);
-
-    if constexpr (is_signed_v<T_To> == is_signed_v<T_From> &&
-                  sizeof(T_To) >= sizeof(T_From)) {
-      // Eg: int64_t from int32_t, uint64_t from uint32_t
-    } else if constexpr (is_unsigned_v<T_To> && is_unsigned_v<T_From>) {
-      // Eg: uint32_t from uint64_t
-      dynamic_check(from <= numeric_limits<T_To>::max(), err_msg);
-    } else if constexpr (is_signed_v<T_To> && is_signed_v<T_From>) {
-      // Eg: int32_t from int64_t
-      dynamic_check(from >= numeric_limits<T_To>::min(), err_msg);
-      dynamic_check(from <= numeric_limits<T_To>::max(), err_msg);
-    } else if constexpr (is_unsigned_v<T_To> && is_signed_v<T_From>) {
-      if constexpr (sizeof(T_To) < sizeof(T_From)) {
-        // Eg: uint32_t from int64_t
-        dynamic_check(from >= 0, err_msg);
-        auto to_max = numeric_limits<T_To>::max();
-        dynamic_check(from <= static_cast<T_From>(to_max), err_msg);
-      } else {
-        // Eg: uint32_t from int32_t, uint64_t from int32_t
-        dynamic_check(from >= 0, err_msg);
-      }
-    } else if constexpr (is_signed_v<T_To> && is_unsigned_v<T_From>) {
-      if constexpr (sizeof(T_To) <= sizeof(T_From)) {
-        // Eg: int32_t from uint32_t, int32_t from uint64_t
-        auto to_max = numeric_limits<T_To>::max();
-        dynamic_check(from <= static_cast<T_From>(to_max), err_msg);
-      } else {
-        // Eg: int64_t from uint32_t
-      }
+    // Read once, as the value may be in sandbox memory
+    T_From val = from;
+    if constexpr (!is_integer_conversion_lossless_v<T_To, T_From>) {
+      dynamic_check(fits_in_integer<T_To>(val),
+                    "Over/Underflow when converting between integer types");
     }
-    to = static_cast<T_To>(from);
+    to = static_cast<T_To>(val);
   }
   else
   {
@@ -140,6 +152,81 @@ inline constexpr void convert_type_fundamental_or_array(T_To& to,
   }
 }
 
+// Calls body with each index below count. The inner loop has a constant trip
+// count, which lets the compiler vectorize it even at -O2.
+template<typename T_Func>
+inline void for_each_index_in_blocks(size_t count, T_Func&& body)
+{
+  constexpr size_t block_size = 16;
+  const size_t block_end = count - count % block_size;
+  for (size_t i = 0; i < block_end; i += block_size) {
+    for (size_t j = 0; j < block_size; j++) {
+      body(i + j);
+    }
+  }
+  for (size_t i = block_end; i < count; i++) {
+    body(i);
+  }
+}
+
+// Converts count values as convert_type_fundamental would. Values with the
+// same representation are copied with memcpy. Others are converted in loops
+// without branches that the compiler can vectorize, and values that don't fit
+// are detected together once the loop is done.
+template<typename T_To, typename T_From>
+inline void convert_range_fundamental(T_To* to,
+                                      const T_From* from,
+                                      size_t count)
+{
+  using namespace std;
+
+  static_assert(is_fundamental_or_enum_v<T_To> &&
+                is_fundamental_or_enum_v<T_From>);
+
+  const char* err_msg = "Over/Underflow when converting between integer types";
+  // Some branches don't use the param
+  RLBOX_UNUSED(err_msg);
+
+  if constexpr (is_same_v<T_To, T_From> ||
+                (is_integral_v<T_To> && is_integral_v<T_From> &&
+                 sizeof(T_To) == sizeof(T_From) &&
+                 is_signed_v<T_To> == is_signed_v<T_From>)) {
+    std::memcpy(to, from, count * sizeof(T_To));
+  } else if constexpr (is_enum_v<T_To> || is_enum_v<T_From>) {
+    static_assert(is_same_v<T_To, T_From>);
+  } else if constexpr (is_floating_point_v<T_To> ||
+                       is_floating_point_v<T_From>) {
+    static_assert(is_floating_point_v<T_To> && is_floating_point_v<T_From>);
+    for_each_index_in_blocks(
+      count, [&](size_t i) { to[i] = static_cast<T_To>(from[i]); });
+  } else if constexpr (is_integer_conversion_lossless_v<T_To, T_From>) {
+    for_each_index_in_blocks(
+      count, [&](size_t i) { to[i] = static_cast<T_To>(from[i]); });
+  } else if constexpr (is_signed_v<T_To> == is_signed_v<T_From>) {
+    // Narrowing between types of the same signedness only loses values that
+    // don't survive being converted back, so collect the bits that change
+    using T_Bits = make_unsigned_t<T_From>;
+    T_Bits changed = 0;
+    for_each_index_in_blocks(count, [&](size_t i) {
+      // Read once, as the value may be in sandbox memory
+      T_From val = from[i];
+      auto converted = static_cast<T_To>(val);
+      changed |= static_cast<T_Bits>(val ^ static_cast<T_From>(converted));
+      to[i] = converted;
+    });
+    dynamic_check(changed == 0, err_msg);
+  } else {
+    bool fits = true;
+    for_each_index_in_blocks(count, [&](size_t i) {
+      // Read once, as the value may be in sandbox memory
+      T_From val = from[i];
+      fits &= fits_in_integer<T_To>(val);
+      to[i] = static_cast<T_To>(val);
+    });
+    dynamic_check(fits, err_msg);
+  }
+}
+
 enum class adjust_type_direction
 {
   TO_SANDBOX,
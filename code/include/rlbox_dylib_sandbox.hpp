@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <cstdlib>
 #include <mutex>
@@ -19,8 +20,15 @@
 #  include <dlfcn.h>
 #endif
 
+#include "rlbox_callback_slots.hpp"
 #include "rlbox_helpers.hpp"
 
+// The number of callbacks that can be registered at once in a sandbox. Each
+// callback signature that is registered instantiates this many trampolines.
+#ifndef RLBOX_DYLIB_SANDBOX_MAX_CALLBACKS
+#  define RLBOX_DYLIB_SANDBOX_MAX_CALLBACKS 64
+#endif
+
 namespace rlbox {
 
 class rlbox_dylib_sandbox;
@@ -28,7 +36,7 @@ class rlbox_dylib_sandbox;
 struct rlbox_dylib_sandbox_thread_data
 {
   rlbox_dylib_sandbox* sandbox;
-  uint32_t last_callback_invoked;
+  void* last_callback_key;
 };
 
 #ifdef RLBOX_EMBEDDER_PROVIDES_TLS_STATIC_VARIABLES
@@ -66,14 +74,18 @@ public:
   using can_grant_deny_access = void;
   // if this plugin uses a separate function to lookup internal callbacks
   using needs_internal_lookup_symbol = void;
+  // this plugin can enter the sandbox once for a batch of calls
+  using can_invoke_batch = void;
+  // values are passed to and from the library unchanged
+  using abi_matches_app = void;
 
 private:
   void* sandbox = nullptr;
 
   RLBOX_SHARED_LOCK(callback_mutex);
-  static inline const uint32_t MAX_CALLBACKS = 64;
-  void* callback_unique_keys[MAX_CALLBACKS]{ 0 };
-  void* callbacks[MAX_CALLBACKS]{ 0 };
+  static inline const uint32_t MAX_CALLBACKS =
+    RLBOX_DYLIB_SANDBOX_MAX_CALLBACKS;
+  detail::callback_slots<MAX_CALLBACKS> callback_table;
 
 #ifndef RLBOX_EMBEDDER_PROVIDES_TLS_STATIC_VARIABLES
   thread_local static inline rlbox_dylib_sandbox_thread_data thread_data{ 0,
@@ -86,21 +98,34 @@ private:
 #ifdef RLBOX_EMBEDDER_PROVIDES_TLS_STATIC_VARIABLES
     auto& thread_data = *get_rlbox_dylib_sandbox_thread_data();
 #endif
-    thread_data.last_callback_invoked = N;
+    // No lock needed, see detail::callback_slots
+    auto entry = thread_data.sandbox->callback_table.load(N);
+    // Record the key now, as the slot may be reused before it is looked up
+    thread_data.last_callback_key = entry.key;
     using T_Func = T_Ret (*)(T_Args...);
-    T_Func func;
-    {
-#ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
-      RLBOX_ACQUIRE_SHARED_GUARD(lock, thread_data.sandbox->callback_mutex);
-#endif
-      func = reinterpret_cast<T_Func>(thread_data.sandbox->callbacks[N]);
-    }
+    auto func = reinterpret_cast<T_Func>(entry.callback);
     // Callbacks are invoked through function pointers, cannot use std::forward
     // as we don't have caller context for T_Args, which means they are all
     // effectively passed by value
     return func(params...);
   }
 
+  template<typename T_Ret, typename... T_Args>
+  static inline void* get_callback_trampoline(uint32_t slot)
+  {
+    // need a compile time for loop as we we need I to be a compile time value
+    // this is because we are returning the I'th callback trampoline
+    static const auto trampolines = [] {
+      std::array<void*, MAX_CALLBACKS> ret{};
+      detail::compile_time_for<MAX_CALLBACKS>([&](auto I) {
+        ret[I.value] = reinterpret_cast<void*>(
+          callback_trampoline<I.value, T_Ret, T_Args...>);
+      });
+      return ret;
+    }();
+    return trampolines[slot];
+  }
+
 protected:
 #if defined(_WIN32)
   using path_buf = const LPCWSTR;
@@ -108,12 +133,22 @@ protected:
   using path_buf = const char*;
 #endif
 
-  inline void impl_create_sandbox(path_buf path)
+  /**
+   * @brief Load the library.
+   *
+   * @param path The path of the library.
+   * @param bind_now If true, the library's own symbol references are resolved
+   * when it is loaded (RTLD_NOW) rather than on first use. This removes the
+   * lazy binding cost from the first calls into the library. It is ignored on
+   * Windows, which always binds imports at load time.
+   */
+  inline void impl_create_sandbox(path_buf path, bool bind_now = false)
   {
 #if defined(_WIN32)
+    RLBOX_UNUSED(bind_now);
     sandbox = (void*)LoadLibraryW(path);
 #else
-    sandbox = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
+    sandbox = dlopen(path, (bind_now ? RTLD_NOW : RTLD_LAZY) | RTLD_LOCAL);
 #endif
 
     if (!sandbox) {
@@ -247,25 +282,38 @@ protected:
     return (*func_ptr)(params...);
   }
 
+  // Enter the sandbox once for a batch of calls made with
+  // impl_invoke_with_func_ptr_in_batch
+  template<typename T_Body>
+  auto impl_invoke_batch(T_Body&& body)
+  {
+#ifdef RLBOX_EMBEDDER_PROVIDES_TLS_STATIC_VARIABLES
+    auto& thread_data = *get_rlbox_dylib_sandbox_thread_data();
+#endif
+    auto old_sandbox = thread_data.sandbox;
+    thread_data.sandbox = this;
+    auto on_exit =
+      detail::make_scope_exit([&] { thread_data.sandbox = old_sandbox; });
+    return body();
+  }
+
+  template<typename T, typename T_Converted, typename... T_Args>
+  auto impl_invoke_with_func_ptr_in_batch(T_Converted* func_ptr,
+                                          T_Args&&... params)
+  {
+    return (*func_ptr)(params...);
+  }
+
   template<typename T_Ret, typename... T_Args>
   inline T_PointerType impl_register_callback(void* key, void* callback)
   {
     RLBOX_ACQUIRE_UNIQUE_GUARD(lock, callback_mutex);
-
-    void* chosen_trampoline = nullptr;
-
-    // need a compile time for loop as we we need I to be a compile time value
-    // this is because we are returning the I'th callback trampoline
-    detail::compile_time_for<MAX_CALLBACKS>([&](auto I) {
-      if (!chosen_trampoline && callback_unique_keys[I.value] == nullptr) {
-        callback_unique_keys[I.value] = key;
-        callbacks[I.value] = callback;
-        chosen_trampoline = reinterpret_cast<void*>(
-          callback_trampoline<I.value, T_Ret, T_Args...>);
-      }
-    });
-
-    return reinterpret_cast<T_PointerType>(chosen_trampoline);
+    uint32_t slot = callback_table.allocate(key, callback);
+    if (slot == MAX_CALLBACKS) {
+      return nullptr;
+    }
+    return reinterpret_cast<T_PointerType>(
+      get_callback_trampoline<T_Ret, T_Args...>(slot));
   }
 
   static inline std::pair<rlbox_dylib_sandbox*, void*>
@@ -275,8 +323,7 @@ protected:
     auto& thread_data = *get_rlbox_dylib_sandbox_thread_data();
 #endif
     auto sandbox = thread_data.sandbox;
-    auto callback_num = thread_data.last_callback_invoked;
-    void* key = sandbox->callback_unique_keys[callback_num];
+    void* key = thread_data.last_callback_key;
     return std::make_pair(sandbox, key);
   }
 
@@ -284,13 +331,7 @@ protected:
   inline void impl_unregister_callback(void* key)
   {
     RLBOX_ACQUIRE_UNIQUE_GUARD(lock, callback_mutex);
-    for (uint32_t i = 0; i < MAX_CALLBACKS; i++) {
-      if (callback_unique_keys[i] == key) {
-        callback_unique_keys[i] = nullptr;
-        callbacks[i] = nullptr;
-        break;
-      }
-    }
+    callback_table.release(key);
   }
 
   template<typename T>
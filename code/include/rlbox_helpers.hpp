@@ -58,6 +58,66 @@ namespace detail {
 
 #define RLBOX_REQUIRE_SEMI_COLON static_assert(true)
 
+// Apply the macro m to each of up to 16 arguments, separated by commas.
+// RLBOX_PP_EXPAND forces MSVC's traditional preprocessor to split
+// __VA_ARGS__ into separate arguments. The trailing 0 passed to
+// RLBOX_PP_SELECT_17 keeps its variadic part non-empty for a single argument.
+#define RLBOX_PP_EXPAND(...) __VA_ARGS__
+#define RLBOX_PP_SELECT_17(                                                    \
+  _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) \
+  N
+#define RLBOX_PP_FOR_EACH_1(m, x) m(x)
+#define RLBOX_PP_FOR_EACH_2(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_1(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_3(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_2(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_4(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_3(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_5(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_4(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_6(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_5(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_7(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_6(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_8(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_7(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_9(m, x, ...)                                         \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_8(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_10(m, x, ...)                                        \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_9(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_11(m, x, ...)                                        \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_10(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_12(m, x, ...)                                        \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_11(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_13(m, x, ...)                                        \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_12(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_14(m, x, ...)                                        \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_13(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_15(m, x, ...)                                        \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_14(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH_16(m, x, ...)                                        \
+  m(x), RLBOX_PP_EXPAND(RLBOX_PP_FOR_EACH_15(m, __VA_ARGS__))
+#define RLBOX_PP_FOR_EACH(m, ...)                                              \
+  RLBOX_PP_EXPAND(RLBOX_PP_EXPAND(RLBOX_PP_SELECT_17(__VA_ARGS__,              \
+                                                     RLBOX_PP_FOR_EACH_16,     \
+                                                     RLBOX_PP_FOR_EACH_15,     \
+                                                     RLBOX_PP_FOR_EACH_14,     \
+                                                     RLBOX_PP_FOR_EACH_13,     \
+                                                     RLBOX_PP_FOR_EACH_12,     \
+                                                     RLBOX_PP_FOR_EACH_11,     \
+                                                     RLBOX_PP_FOR_EACH_10,     \
+                                                     RLBOX_PP_FOR_EACH_9,      \
+                                                     RLBOX_PP_FOR_EACH_8,      \
+                                                     RLBOX_PP_FOR_EACH_7,      \
+                                                     RLBOX_PP_FOR_EACH_6,      \
+                                                     RLBOX_PP_FOR_EACH_5,      \
+                                                     RLBOX_PP_FOR_EACH_4,      \
+                                                     RLBOX_PP_FOR_EACH_3,      \
+                                                     RLBOX_PP_FOR_EACH_2,      \
+                                                     RLBOX_PP_FOR_EACH_1,      \
+                                                     0))(                      \
+    m, __VA_ARGS__))
+
 #define if_constexpr_named(varName, ...)                                       \
   if constexpr (constexpr auto varName = __VA_ARGS__; varName)
 
@@ -211,7 +271,16 @@ But C++ doesn't seem to allow the above
   friend class sandbox_callback;                                               \
                                                                                \
   template<typename U1, typename U2>                                           \
-  friend class app_pointer;
+  friend class sandbox_function;                                               \
+                                                                               \
+  template<typename U1, typename U2>                                           \
+  friend class app_pointer;                                                    \
+                                                                               \
+  template<typename U1>                                                        \
+  friend class sandbox_slab_allocator;                                         \
+                                                                               \
+  template<typename U1>                                                        \
+  friend class sandbox_frame;
 }
 
 }
@@ -0,0 +1,218 @@
+#pragma once
+// IWYU pragma: private, include "rlbox.hpp"
+// IWYU pragma: friend "rlbox_.*\.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rlbox::detail {
+
+/**
+ * @brief Linear probing over a power of two sized table of entries keyed by
+ * non-null pointers, where a null key marks an empty entry. This holds the
+ * probing and deletion logic shared by pointer_set and fixed_pointer_map.
+ *
+ * @tparam T_Entry The table entry, whose value initialization is empty.
+ * @tparam T_GetKey Has a static get function returning the key of an entry.
+ */
+template<typename T_Entry, typename T_GetKey>
+class pointer_probe
+{
+public:
+  static inline size_t get_home(const void* p, size_t mask)
+  {
+    // Mix the bits, as pointers share their low and high bits
+    auto val = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(p));
+    val ^= val >> 33;
+    val *= 0xff51afd7ed558ccdULL;
+    val ^= val >> 33;
+    return static_cast<size_t>(val) & mask;
+  }
+
+  /**
+   * @brief The entry holding p, or the empty entry where p would go. The
+   * table must have an empty entry.
+   */
+  static inline size_t find(const T_Entry* entries, size_t mask, const void* p)
+  {
+    size_t i = get_home(p, mask);
+    while (true) {
+      const void* key = T_GetKey::get(entries[i]);
+      if (key == nullptr || key == p) {
+        return i;
+      }
+      i = (i + 1) & mask;
+    }
+  }
+
+  /**
+   * @brief Empty the full entry i. Erase shifts later entries back instead of
+   * leaving tombstones, so the table doesn't degrade as entries come and go.
+   */
+  static inline void erase(T_Entry* entries, size_t mask, size_t i)
+  {
+    // Move back any later entries in the probe run that can no longer reach
+    // their slot past the hole
+    size_t j = i;
+    while (true) {
+      j = (j + 1) & mask;
+      const void* key = T_GetKey::get(entries[j]);
+      if (key == nullptr) {
+        break;
+      }
+      size_t home = get_home(key, mask);
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        entries[i] = entries[j];
+        i = j;
+      }
+    }
+    entries[i] = T_Entry{};
+  }
+};
+
+/**
+ * @brief A set of non-null pointers, stored in an open-addressing hash table
+ * with linear probing. Insert, erase and lookup are O(1) on average. This
+ * class is not thread-safe.
+ */
+class pointer_set
+{
+  struct get_key
+  {
+    static inline const void* get(const void* p) { return p; }
+  };
+  using probe = pointer_probe<const void*, get_key>;
+
+  // Null marks an empty slot. The size is zero or a power of two.
+  std::vector<const void*> slots;
+  size_t count = 0;
+
+  static constexpr size_t initial_capacity = 16;
+
+  // The slot holding p, or the empty slot where p would go
+  inline size_t find_slot(const void* p) const
+  {
+    return probe::find(slots.data(), slots.size() - 1, p);
+  }
+
+  inline void grow()
+  {
+    std::vector<const void*> prev(
+      slots.empty() ? initial_capacity : slots.size() * 2, nullptr);
+    prev.swap(slots);
+    for (auto p : prev) {
+      if (p != nullptr) {
+        slots[find_slot(p)] = p;
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Add a pointer to the set.
+   *
+   * @return False if the pointer was already in the set.
+   */
+  inline bool insert(const void* p)
+  {
+    // Keep the load factor at most 1/2
+    if ((count + 1) * 2 > slots.size()) {
+      grow();
+    }
+    size_t i = find_slot(p);
+    if (slots[i] != nullptr) {
+      return false;
+    }
+    slots[i] = p;
+    count++;
+    return true;
+  }
+
+  /**
+   * @brief Remove a pointer from the set.
+   *
+   * @return False if the pointer was not in the set.
+   */
+  inline bool erase(const void* p)
+  {
+    if (count == 0) {
+      return false;
+    }
+    size_t i = find_slot(p);
+    if (slots[i] == nullptr) {
+      return false;
+    }
+    probe::erase(slots.data(), slots.size() - 1, i);
+    count--;
+    return true;
+  }
+
+  inline bool contains(const void* p) const
+  {
+    return count != 0 && slots[find_slot(p)] != nullptr;
+  }
+
+  inline size_t size() const noexcept { return count; }
+};
+
+/**
+ * @brief A map from non-null pointers to values that holds at most N entries,
+ * stored inline in an open-addressing hash table that is never more than half
+ * full, so it never allocates. This class is not thread-safe.
+ */
+template<typename T_Value, size_t N>
+class fixed_pointer_map
+{
+  struct entry
+  {
+    const void* key;
+    T_Value value;
+  };
+  struct get_key
+  {
+    static inline const void* get(const entry& e) { return e.key; }
+  };
+  using probe = pointer_probe<entry, get_key>;
+
+  static constexpr size_t get_table_size()
+  {
+    size_t ret = 1;
+    while (ret < 2 * N) {
+      ret *= 2;
+    }
+    return ret;
+  }
+  static constexpr size_t mask = get_table_size() - 1;
+
+  entry entries[get_table_size()]{};
+
+public:
+  /**
+   * @brief Add a pointer that isn't in the map. The map must have fewer than
+   * N entries.
+   */
+  inline void insert(const void* p, T_Value value)
+  {
+    entries[probe::find(entries, mask, p)] = entry{ p, value };
+  }
+
+  /**
+   * @brief Remove a pointer from the map.
+   *
+   * @return False if the pointer was not in the map, otherwise true with its
+   * value stored in value.
+   */
+  inline bool erase(const void* p, T_Value& value)
+  {
+    size_t i = probe::find(entries, mask, p);
+    if (entries[i].key == nullptr) {
+      return false;
+    }
+    value = entries[i].value;
+    probe::erase(entries, mask, i);
+    return true;
+  }
+};
+
+}
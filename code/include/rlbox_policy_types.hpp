@@ -2,6 +2,8 @@
 // IWYU pragma: private, include "rlbox.hpp"
 // IWYU pragma: friend "rlbox_.*\.hpp"
 
+#include <functional>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
@@ -175,6 +177,159 @@ public:
   }
 };
 
+namespace sandbox_function_call_detail {
+
+  // Callbacks can't be copied, so bound calls hold a reference to them
+  // instead. The callback must remain registered until the call is made.
+  template<typename T>
+  using param_t =
+    std::conditional_t<detail::rlbox_is_sandbox_callback_v<std::decay_t<T>>,
+                       std::reference_wrapper<std::remove_reference_t<T>>,
+                       std::decay_t<T>>;
+
+  // A temporary callback would be unregistered before the bound call is made
+  template<typename T>
+  constexpr bool is_bindable_v =
+    !detail::rlbox_is_sandbox_callback_v<std::decay_t<T>> ||
+    std::is_lvalue_reference_v<T>;
+
+  template<typename T>
+  inline T& unwrap(T& param)
+  {
+    return param;
+  }
+
+  template<typename T>
+  inline T& unwrap(std::reference_wrapper<T>& param)
+  {
+    return param.get();
+  }
+}
+
+/**
+ * @brief A handle to a sandboxed function whose address has been looked up
+ * once, so that it can be invoked repeatedly without a symbol lookup on each
+ * call. Create handles with get_sandbox_function. A handle is only valid as
+ * long as the sandbox it was created from.
+ *
+ * @tparam T The type of the sandboxed function, for example
+ * `decltype(foo)`.
+ */
+template<typename T, typename T_Sbx>
+class sandbox_function
+{
+  KEEP_CLASSES_FRIENDLY
+
+private:
+  rlbox_sandbox<T_Sbx>* sandbox;
+  const char* func_name;
+  void* func_ptr;
+
+  // Keep constructor private as only rlbox_sandbox should be able to create
+  // this object
+  sandbox_function(rlbox_sandbox<T_Sbx>* p_sandbox,
+                   const char* p_func_name,
+                   void* p_func_ptr)
+    : sandbox(p_sandbox)
+    , func_name(p_func_name)
+    , func_ptr(p_func_ptr)
+  {
+    detail::dynamic_check(
+      sandbox != nullptr,
+      "Unexpected null sandbox when creating a sandbox function");
+  }
+
+public:
+  sandbox_function()
+    : sandbox(nullptr)
+    , func_name(nullptr)
+    , func_ptr(nullptr)
+  {
+  }
+
+  sandbox_function(const sandbox_function&) = default;
+  sandbox_function& operator=(const sandbox_function&) = default;
+
+  /**
+   * @brief Check if the handle does _not_ refer to a sandboxed function.
+   */
+  inline bool is_unresolved() const noexcept { return sandbox == nullptr; }
+
+  /**
+   * @brief Call the sandboxed function.
+   *
+   * @param params Arguments to function should be simple or tainted values.
+   * @return Tainted value or void.
+   */
+  template<typename... T_Args>
+  inline auto operator()(T_Args&&... params) const
+  {
+    RLBOX_DEBUG_ASSERT(sandbox != nullptr);
+    return sandbox->template INTERNAL_invoke_with_func_ptr<T>(
+      func_name, func_ptr, std::forward<T_Args>(params)...);
+  }
+
+  /**
+   * @brief Bind arguments to the sandboxed function without calling it. The
+   * result can be passed to rlbox_sandbox::invoke_sandbox_batch.
+   *
+   * @param params Arguments to function should be simple or tainted values.
+   * These are copied into the returned object, except for callbacks which are
+   * referenced and must outlive the returned object. Callbacks must therefore
+   * be lvalues.
+   */
+  template<typename... T_Args>
+  inline auto bind(T_Args&&... params) const
+  {
+    static_assert((sandbox_function_call_detail::is_bindable_v<T_Args> && ...),
+                  "Callbacks passed to bind_sandbox_function or "
+                  "invoke_sandbox_function_async are held by reference and "
+                  "can't be temporaries. Register the callback in a variable "
+                  "that outlives the call.");
+    RLBOX_DEBUG_ASSERT(sandbox != nullptr);
+    return sandbox_function_call<T,
+                                 T_Sbx,
+                                 sandbox_function_call_detail::param_t<T_Args>...>(
+      *this, std::forward<T_Args>(params)...);
+  }
+
+  /**
+   * @brief Call the sandboxed function on the sandbox's worker thread. See
+   * rlbox_sandbox::invoke_sandbox_function_async.
+   *
+   * @param params Arguments to function should be simple or tainted values.
+   * @return A std::future holding the tainted result.
+   */
+  template<typename... T_Args>
+  inline auto invoke_async(T_Args&&... params) const
+  {
+    RLBOX_DEBUG_ASSERT(sandbox != nullptr);
+    return sandbox->INTERNAL_invoke_async(bind(std::forward<T_Args>(params)...));
+  }
+};
+
+/**
+ * @brief A sandboxed function along with the arguments it should be called
+ * with. Create these with sandbox_function::bind or bind_sandbox_function and
+ * call them with rlbox_sandbox::invoke_sandbox_batch.
+ */
+template<typename T, typename T_Sbx, typename... T_Args>
+class sandbox_function_call
+{
+  KEEP_CLASSES_FRIENDLY
+
+private:
+  sandbox_function<T, T_Sbx> func;
+  std::tuple<T_Args...> params;
+
+  template<typename... T_ArgsRef>
+  sandbox_function_call(const sandbox_function<T, T_Sbx>& p_func,
+                        T_ArgsRef&&... p_params)
+    : func(p_func)
+    , params(std::forward<T_ArgsRef>(p_params)...)
+  {}
+};
+
 template<typename T, typename T_Sbx>
 class app_pointer
 {
@@ -2,7 +2,10 @@
 // IWYU pragma: private, include "rlbox.hpp"
 // IWYU pragma: friend "rlbox_.*\.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 
 #include "rlbox_types.hpp"
 
@@ -28,4 +31,38 @@ inline void check_sandbox_pointer_range_is_contained(const void* ptr,
   }
 }
 
-}
\ No newline at end of file
+// The length of the null terminated string at str, which is in sandbox
+// memory, or limit if the first limit bytes have no terminator. The scan also
+// stops at the end of the sandbox's memory, so a string without a terminator
+// can't make it read past the sandbox. The end is taken from sandbox if given,
+// and otherwise found by looking up the sandbox that str is in.
+template<typename T_Sbx>
+inline size_t get_sandbox_string_length(
+  rlbox_sandbox<T_Sbx>* sandbox,
+  const char* str,
+  size_t limit = std::numeric_limits<size_t>::max())
+{
+  const size_t unknown = std::numeric_limits<size_t>::max();
+  size_t max_len = unknown;
+  if (sandbox != nullptr) {
+    max_len = sandbox->get_memory_remaining(str);
+  }
+  if (max_len == unknown) {
+    max_len = rlbox_sandbox<T_Sbx>::get_memory_remaining_no_ctx(str);
+  }
+  if (max_len == unknown && limit == unknown) {
+    // The end of the sandbox's memory isn't known, so the scan is unbounded
+    return std::strlen(str);
+  }
+
+  size_t bound = std::min(max_len, limit);
+  auto end = static_cast<const char*>(std::memchr(str, '\0', bound));
+  if (end != nullptr) {
+    return static_cast<size_t>(end - str);
+  }
+  detail::dynamic_check(bound == limit,
+                        "String is not null terminated in sandbox memory");
+  return limit;
+}
+
+}
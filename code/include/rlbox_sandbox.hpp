@@ -9,24 +9,27 @@
 #endif
 #include <cstdlib>
 #include <limits>
-#include <map>
+#include <initializer_list>
 #include <mutex>
-#include <string>
 #ifndef RLBOX_USE_CUSTOM_SHARED_LOCK
 #  include <shared_mutex>
 #endif
-#ifdef RLBOX_MEASURE_TRANSITION_TIMES
-#  include <sstream>
-#endif
 #include <stdint.h>
 #include <type_traits>
+#include <tuple>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "rlbox_conversion.hpp"
 #include "rlbox_helpers.hpp"
+#include "rlbox_pointer_set.hpp"
+#include "rlbox_sandbox_frame.hpp"
+#include "rlbox_sandbox_index.hpp"
 #include "rlbox_stdlib_polyfill.hpp"
 #include "rlbox_struct_support.hpp"
+#include "rlbox_symbol_cache.hpp"
+#include "rlbox_transition_timing.hpp"
 #include "rlbox_type_traits.hpp"
 #include "rlbox_wrapper_traits.hpp"
 
@@ -36,6 +39,35 @@ using namespace std::chrono;
 
 namespace rlbox {
 
+namespace detail {
+  // Used by prebind_sandbox_functions so that each name it is given must be a
+  // declared function
+  template<typename T>
+  constexpr const char* prebind_function_name(const char* func_name)
+  {
+    static_assert(std::is_function_v<T>,
+                  "prebind_sandbox_functions expects sandboxed function names");
+    return func_name;
+  }
+
+  // Asynchronous invocation is opt-in and lives in rlbox_sandbox_worker.hpp.
+  // Sandboxes own their worker through this base, so that they don't depend on
+  // the worker's headers.
+  class sandbox_worker_base
+  {
+  public:
+    virtual ~sandbox_worker_base() = default;
+    // Whether the caller is running on the worker's thread
+    virtual bool is_worker_thread() const = 0;
+    // Used instead of delete from a task running on the worker's thread
+    virtual void abandon() = 0;
+  };
+
+  // Defined in rlbox_sandbox_worker.hpp
+  template<typename T_Sbx>
+  struct sandbox_async_invoker;
+}
+
 namespace convert_fn_ptr_to_sandbox_equivalent_detail {
   template<typename T, typename T_Sbx>
   using conv = ::rlbox::detail::convert_to_sandbox_equivalent_t<T, T_Sbx>;
@@ -48,37 +80,6 @@ namespace convert_fn_ptr_to_sandbox_equivalent_detail {
     T_Ret (*)(T_Args...));
 }
 
-#if defined(RLBOX_MEASURE_TRANSITION_TIMES) ||                                 \
-  defined(RLBOX_TRANSITION_ACTION_OUT) || defined(RLBOX_TRANSITION_ACTION_IN)
-enum class rlbox_transition
-{
-  INVOKE,
-  CALLBACK
-};
-#endif
-#ifdef RLBOX_MEASURE_TRANSITION_TIMES
-struct rlbox_transition_timing
-{
-  rlbox_transition invoke;
-  const char* name;
-  void* ptr;
-  int64_t time;
-
-  std::string to_string()
-  {
-    std::ostringstream ret;
-    if (invoke == rlbox_transition::INVOKE) {
-      ret << name;
-    } else {
-      ret << "Callback " << ptr;
-    }
-    ret << " : " << time << "\n";
-
-    return ret.str();
-  }
-};
-#endif
-
 /**
  * @brief Encapsulation for sandboxes.
  *
@@ -92,20 +93,16 @@ class rlbox_sandbox : protected T_Sbx
 
 private:
 #ifdef RLBOX_MEASURE_TRANSITION_TIMES
-#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
-  RLBOX_SHARED_LOCK(transition_times_lock);
-#  endif
-  std::vector<rlbox_transition_timing> transition_times;
+  detail::transition_times_recorder transition_times;
 #endif
 
-  static inline RLBOX_SHARED_LOCK(sandbox_list_lock);
-  // The actual type of the vector is std::vector<rlbox_sandbox<T_Sbx>*>
-  // However clang 5, 6 have bugs where compilation seg-faults on this type
-  // So we just use this std::vector<void*>
-  static inline std::vector<void*> sandbox_list;
+  // All live sandboxes of this type, indexed by their memory ranges
+  static inline detail::sandbox_index<rlbox_sandbox<T_Sbx>> sandbox_list;
+  typename detail::sandbox_index<rlbox_sandbox<T_Sbx>>::registration
+    sandbox_list_slot = nullptr;
 
-  RLBOX_SHARED_LOCK(func_ptr_cache_lock);
-  std::map<std::string, void*> func_ptr_map;
+  // This is thread-safe so no locks needed
+  detail::symbol_cache func_ptr_cache;
 
   // This is thread-safe so no locks needed
   app_pointer_map<typename T_Sbx::T_PointerType> app_ptr_map;
@@ -128,10 +125,16 @@ private:
   std::atomic<Sandbox_Status> sandbox_created = Sandbox_Status::NOT_CREATED;
 
   std::mutex callback_lock;
-  std::vector<void*> callback_keys;
+  detail::pointer_set callback_keys;
 
   void* transition_state = nullptr;
 
+  // Started on the first asynchronous invocation
+  std::atomic<detail::sandbox_worker_base*> async_worker{ nullptr };
+
+  // Scratch memory for sandbox_frames, allocated on first use by each thread
+  detail::scratch_regions scratch;
+
   template<typename T>
   using convert_fn_ptr_to_sandbox_equivalent_t =
     decltype(::rlbox::convert_fn_ptr_to_sandbox_equivalent_detail::helper<
@@ -179,6 +182,29 @@ private:
     }
   }
 
+  // Values of these types are represented identically in the sandbox, so
+  // conversions can be skipped. Function pointers are excluded as they are
+  // swizzled through callback trampolines.
+  template<typename T>
+  static constexpr bool can_skip_conversion()
+  {
+    return detail::is_abi_identical_v<T_Sbx> &&
+           (std::is_arithmetic_v<T> ||
+            (std::is_pointer_v<T> && !detail::is_func_ptr_v<T>));
+  }
+
+  // Used in place of convert_type when can_skip_conversion holds
+  template<typename T_To, typename T_From>
+  static inline T_To convert_unchanged(const T_From& val)
+  {
+    if constexpr (std::is_pointer_v<T_To>) {
+      auto ptr = const_cast<void*>(static_cast<const volatile void*>(val));
+      return static_cast<T_To>(ptr);
+    } else {
+      return static_cast<T_To>(val);
+    }
+  }
+
   template<typename T>
   inline auto invoke_process_param(T&& param)
   {
@@ -186,7 +212,16 @@ private:
 
     using T_NoRef = std::remove_reference_t<T>;
 
-    if constexpr (detail::rlbox_is_tainted_opaque_v<T_NoRef>) {
+    if constexpr (detail::is_abi_identical_v<T_Sbx> &&
+                  std::is_arithmetic_v<T_NoRef>) {
+      // No need to adjust for the machine model
+      return param;
+    } else if constexpr (detail::is_abi_identical_v<T_Sbx> &&
+                         detail::rlbox_is_tainted_v<T_NoRef> &&
+                         std::is_arithmetic_v<
+                           detail::rlbox_remove_wrapper_t<T_NoRef>>) {
+      return param.UNSAFE_unverified();
+    } else if constexpr (detail::rlbox_is_tainted_opaque_v<T_NoRef>) {
       auto ret = from_opaque(param);
       return ret.UNSAFE_sandboxed(*this);
     } else if constexpr (detail::rlbox_is_wrapper_v<T_NoRef>) {
@@ -211,21 +246,115 @@ private:
     }
   }
 
+  // Invoke a sandbox function without running transition hooks or timers.
+  // When T_InBatch is set, the caller has already entered the sandbox with the
+  // plugin's impl_invoke_batch.
+  template<typename T, bool T_InBatch, typename... T_Args>
+  inline auto invoke_with_func_ptr_no_transition(void* func_ptr,
+                                                 T_Args&&... params)
+  {
+    (check_invoke_param_type_is_ok<T_Args>(), ...);
+
+    static_assert(
+      rlbox::detail::polyfill::is_invocable_v<
+        T,
+        detail::rlbox_remove_wrapper_t<std::remove_reference_t<T_Args>>...>,
+      "Mismatched arguments types for function");
+
+    using T_Result = rlbox::detail::polyfill::invoke_result_t<
+      T,
+      detail::rlbox_remove_wrapper_t<std::remove_reference_t<T_Args>>...>;
+
+    using T_Converted =
+      std::remove_pointer_t<convert_fn_ptr_to_sandbox_equivalent_t<T*>>;
+
+    auto converted_func_ptr = reinterpret_cast<T_Converted*>(func_ptr);
+
+    if constexpr (std::is_void_v<T_Result>) {
+      if constexpr (T_InBatch) {
+        this->template impl_invoke_with_func_ptr_in_batch<T>(
+          converted_func_ptr, invoke_process_param(params)...);
+      } else {
+        this->template impl_invoke_with_func_ptr<T>(
+          converted_func_ptr, invoke_process_param(params)...);
+      }
+      return;
+    } else {
+      auto raw_result = [&]() {
+        if constexpr (T_InBatch) {
+          return this->template impl_invoke_with_func_ptr_in_batch<T>(
+            converted_func_ptr, invoke_process_param(params)...);
+        } else {
+          return this->template impl_invoke_with_func_ptr<T>(
+            converted_func_ptr, invoke_process_param(params)...);
+        }
+      }();
+      if constexpr (can_skip_conversion<T_Result>()) {
+        return tainted<T_Result, T_Sbx>::internal_factory(
+          convert_unchanged<T_Result>(raw_result));
+      } else {
+        tainted<T_Result, T_Sbx> wrapped_result;
+        using namespace detail;
+        convert_type<T_Sbx,
+                     adjust_type_direction::TO_APPLICATION,
+                     adjust_type_context::SANDBOX>(
+          wrapped_result.get_raw_value_ref(),
+          raw_result,
+          nullptr /* example_unsandboxed_ptr */,
+          this /* sandbox_ptr */);
+        return wrapped_result;
+      }
+    }
+  }
+
+  template<bool T_InBatch, typename T, typename... T_Args>
+  inline auto invoke_batch_call(
+    const sandbox_function_call<T, T_Sbx, T_Args...>& call)
+  {
+    detail::dynamic_check(call.func.sandbox == this,
+                          "invoke_sandbox_batch called with a function from "
+                          "a different sandbox");
+    // Copy the arguments as const tainted values can't be passed to sandbox
+    // functions
+    auto params_copy = call.params;
+    return std::apply(
+      [&](T_Args&... params) {
+        using sandbox_function_call_detail::unwrap;
+        using T_Result =
+          decltype(invoke_with_func_ptr_no_transition<T, T_InBatch>(
+            nullptr, unwrap(params)...));
+        if constexpr (std::is_void_v<T_Result>) {
+          invoke_with_func_ptr_no_transition<T, T_InBatch>(call.func.func_ptr,
+                                                           unwrap(params)...);
+          return std::monostate{};
+        } else {
+          return invoke_with_func_ptr_no_transition<T, T_InBatch>(
+            call.func.func_ptr, unwrap(params)...);
+        }
+      },
+      params_copy);
+  }
+
   template<typename T, typename T_Arg>
   inline tainted<T, T_Sbx> sandbox_callback_intercept_convert_param(
     rlbox_sandbox<T_Sbx>& sandbox,
     const T_Arg& arg)
   {
-    tainted<T, T_Sbx> ret;
-    using namespace detail;
-    convert_type<T_Sbx,
-                 adjust_type_direction::TO_APPLICATION,
-                 adjust_type_context::SANDBOX>(
-      ret.get_raw_value_ref(),
-      arg,
-      nullptr /* example_unsandboxed_ptr */,
-      &sandbox);
-    return ret;
+    if constexpr (can_skip_conversion<T>()) {
+      RLBOX_UNUSED(sandbox);
+      return tainted<T, T_Sbx>::internal_factory(convert_unchanged<T>(arg));
+    } else {
+      tainted<T, T_Sbx> ret;
+      using namespace detail;
+      convert_type<T_Sbx,
+                   adjust_type_direction::TO_APPLICATION,
+                   adjust_type_context::SANDBOX>(
+        ret.get_raw_value_ref(),
+        arg,
+        nullptr /* example_unsandboxed_ptr */,
+        &sandbox);
+      return ret;
+    }
   }
 
   template<typename T_Ret, typename... T_Args>
@@ -245,19 +374,13 @@ private:
     auto target_fn_ptr = reinterpret_cast<T_Func>(key);
 
 #ifdef RLBOX_MEASURE_TRANSITION_TIMES
-    high_resolution_clock::time_point enter_time = high_resolution_clock::now();
+    rlbox::detail::transition_timer<rlbox_transition::CALLBACK> timer;
     auto on_exit = rlbox::detail::make_scope_exit([&] {
-      auto exit_time = high_resolution_clock::now();
-      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
-      {
-#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
-        RLBOX_ACQUIRE_UNIQUE_GUARD(transition_times_lock);
-#  endif
-        sandbox.transition_times.push_back(
-          rlbox_transition_timing{ rlbox_transition::CALLBACK,
-                                   nullptr /* func_name */,
-                                   key /* func_ptr */,
-                                   ns });
+      if (timer.is_sampled()) {
+        sandbox.transition_times.record(rlbox_transition::CALLBACK,
+                                        nullptr /* func_name */,
+                                        key /* func_ptr */,
+                                        timer.get_elapsed_ns());
       }
     });
 #endif
@@ -289,13 +412,18 @@ private:
 
       using namespace detail;
       convert_to_sandbox_equivalent_t<T_Ret, T_Sbx> ret;
-      convert_type<T_Sbx,
-                   adjust_type_direction::TO_SANDBOX,
-                   adjust_type_context::SANDBOX>(
-        ret,
-        tainted_ret.get_raw_value_ref(),
-        nullptr /* example_unsandboxed_ptr */,
-        &sandbox);
+      if constexpr (can_skip_conversion<T_Ret>()) {
+        ret = convert_unchanged<convert_to_sandbox_equivalent_t<T_Ret, T_Sbx>>(
+          tainted_ret.get_raw_value_ref());
+      } else {
+        convert_type<T_Sbx,
+                     adjust_type_direction::TO_SANDBOX,
+                     adjust_type_context::SANDBOX>(
+          ret,
+          tainted_ret.get_raw_value_ref(),
+          nullptr /* example_unsandboxed_ptr */,
+          &sandbox);
+      }
       return ret;
     }
   }
@@ -318,11 +446,10 @@ private:
       detail::convert_to_sandbox_equivalent_t<T_Args, T_Sbx>...>(key);
 
     std::lock_guard<std::mutex> lock(callback_lock);
-    auto el_ref = std::find(callback_keys.begin(), callback_keys.end(), key);
+    bool removed = callback_keys.erase(key);
     detail::dynamic_check(
-      el_ref != callback_keys.end(),
+      removed,
       "Unexpected state. Unregistering a callback that was never registered.");
-    callback_keys.erase(el_ref);
   }
 
   static T_Sbx* find_sandbox_from_example(const void* example_sandbox_ptr)
@@ -331,15 +458,7 @@ private:
       example_sandbox_ptr != nullptr,
       "Internal error: received a null example pointer. Please file a bug.");
 
-    RLBOX_ACQUIRE_SHARED_GUARD(lock, sandbox_list_lock);
-    for (auto sandbox_v : sandbox_list) {
-      auto sandbox = reinterpret_cast<rlbox_sandbox<T_Sbx>*>(sandbox_v);
-      if (sandbox->is_pointer_in_sandbox_memory(example_sandbox_ptr)) {
-        return sandbox;
-      }
-    }
-
-    return nullptr;
+    return sandbox_list.find(example_sandbox_ptr);
   }
 
   template<typename... T_Args>
@@ -373,6 +492,70 @@ private:
     return ret;
   }
 
+  // The scratch region of the current thread, used by sandbox_frame. The
+  // region's memory is allocated on first use, and stays unallocated if the
+  // sandbox is out of memory.
+  inline detail::scratch_regions::region* get_thread_scratch_region()
+  {
+    auto region = scratch.get_thread_region();
+    if (region->start == nullptr) {
+      const uint32_t size = RLBOX_SANDBOX_SCRATCH_SIZE;
+      auto mem = malloc_in_sandbox<char>(size);
+      if (mem != nullptr) {
+        region->start = mem.UNSAFE_unverified();
+        region->size = size;
+      }
+    }
+    return region;
+  }
+
+  // Allocates total_size bytes in sandbox memory and checks that the whole
+  // range is in sandbox memory. Returns null if the sandbox's malloc fails.
+  template<typename T>
+  inline T* malloc_in_sandbox_range(size_t total_size)
+  {
+    if constexpr (sizeof(size_t) == 4) {
+      // On a 32-bit platform, we need to make sure that total_size is not >=4GB
+      detail::dynamic_check(total_size < std::numeric_limits<uint32_t>::max(),
+                            "Tried to allocate memory over 4GB");
+    } else if constexpr (sizeof(size_t) != 8) {
+      // Double check we are on a 64-bit platform
+      // Note for static checks we need to have some dependence on T, so adding
+      // a dummy
+      constexpr bool dummy = sizeof(T) >= 0;
+      rlbox_detail_static_fail_because(dummy && sizeof(size_t) != 8,
+                                       "Expected 32 or 64 bit platform.");
+    }
+    auto ptr_in_sandbox = this->impl_malloc_in_sandbox(total_size);
+    auto ptr = get_unsandboxed_pointer<T*>(ptr_in_sandbox);
+    if (!ptr) {
+      return nullptr;
+    }
+    detail::dynamic_check(is_pointer_in_sandbox_memory(ptr),
+                          "Malloc returned pointer outside the sandbox memory");
+
+    auto ptr_end = checked_add(reinterpret_cast<uintptr_t>(ptr),
+                               reinterpret_cast<uintptr_t>(total_size - 1),
+                               "Malloc object end too large");
+    detail::dynamic_check(
+      is_pointer_in_sandbox_memory(reinterpret_cast<const char*>(ptr_end)),
+      "Malloc returned a pointer whose range goes beyond sandbox memory");
+    return reinterpret_cast<T*>(ptr);
+  }
+
+  template<typename... T_Types, size_t... T_Indices>
+  static inline std::tuple<tainted<T_Types*, T_Sbx>...> make_batch_tuple(
+    char* ptr,
+    const size_t* offsets,
+    std::index_sequence<T_Indices...>)
+  {
+    if (ptr == nullptr) {
+      return std::make_tuple(tainted<T_Types*, T_Sbx>(nullptr)...);
+    }
+    return std::make_tuple(tainted<T_Types*, T_Sbx>::internal_factory(
+      reinterpret_cast<T_Types*>(ptr + offsets[T_Indices]))...);
+  }
+
 public:
   /**
    * @brief Unused member that allows the calling code to save data in a
@@ -394,6 +577,20 @@ public:
 
   T_Sbx* get_sandbox_impl() { return this; }
 
+  ~rlbox_sandbox()
+  {
+    // In case the sandbox is freed without calling destroy_sandbox
+    auto worker = async_worker.load();
+    if (worker != nullptr && worker->is_worker_thread()) {
+      // The sandbox is being freed by one of its own asynchronous
+      // invocations, so the worker can't be joined here. Queued invocations
+      // can't run without the sandbox, so they are abandoned.
+      worker->abandon();
+    } else {
+      delete worker;
+    }
+  }
+
   /**
    * @brief Create a new sandbox.
    *
@@ -404,12 +601,9 @@ public:
   inline bool create_sandbox(T_Args... args)
   {
 #ifdef RLBOX_MEASURE_TRANSITION_TIMES
-    // Warm up the timer. The first call is always slow (at least on the test
-    // platform)
-    for (int i = 0; i < 10; i++) {
-      auto val = high_resolution_clock::now();
-      RLBOX_UNUSED(val);
-    }
+    // Calibrate the clock and measure its overhead once, so this cost isn't
+    // paid by the first transition
+    detail::calibrate_transition_clock();
 #endif
     auto expected = Sandbox_Status::NOT_CREATED;
     bool success = sandbox_created.compare_exchange_strong(
@@ -437,8 +631,7 @@ public:
 
     if (created) {
       sandbox_created.store(Sandbox_Status::CREATED);
-      RLBOX_ACQUIRE_UNIQUE_GUARD(lock, sandbox_list_lock);
-      sandbox_list.push_back(this);
+      sandbox_list_slot = sandbox_list.add(this);
     }
 
     return created;
@@ -449,6 +642,13 @@ public:
    */
   inline auto destroy_sandbox()
   {
+    auto worker = async_worker.load();
+    detail::dynamic_check(
+      worker == nullptr || !worker->is_worker_thread(),
+      "destroy_sandbox called from an asynchronous invocation of the same "
+      "sandbox. destroy_sandbox waits for these invocations to finish, so it "
+      "should be called from another thread.");
+
     auto expected = Sandbox_Status::CREATED;
     bool success = sandbox_created.compare_exchange_strong(
       expected, Sandbox_Status::CLEANING_UP /* desired */);
@@ -458,14 +658,19 @@ public:
       "destroy_sandbox called without sandbox creation/is being "
       "destroyed concurrently");
 
-    {
-      RLBOX_ACQUIRE_UNIQUE_GUARD(lock, sandbox_list_lock);
-      auto el_ref = std::find(sandbox_list.begin(), sandbox_list.end(), this);
-      detail::dynamic_check(
-        el_ref != sandbox_list.end(),
-        "Unexpected state. Destroying a sandbox that was never initialized.");
-      sandbox_list.erase(el_ref);
-    }
+    // Finish any queued asynchronous invocations while the sandbox is usable.
+    // Destroying the worker waits for its queue to drain.
+    delete async_worker.exchange(nullptr);
+
+    // This also invalidates any lookups of this sandbox cached by threads
+    sandbox_list.remove(std::exchange(sandbox_list_slot, nullptr));
+
+    // Symbols may resolve differently if the sandbox is created again
+    func_ptr_cache.clear();
+
+    scratch.clear([this](char* p) {
+      this->impl_free_in_sandbox(get_sandboxed_pointer<char*>(p));
+    });
 
     sandbox_created.store(Sandbox_Status::NOT_CREATED);
     return this->impl_destroy_sandbox();
@@ -567,34 +772,85 @@ public:
     }
     const size_t total_size = checked_multiply(
       static_cast<size_t>(count), sizeof(T), "Malloc object size too large");
-    if constexpr (sizeof(size_t) == 4) {
-      // On a 32-bit platform, we need to make sure that total_size is not >=4GB
-      detail::dynamic_check(total_size < std::numeric_limits<uint32_t>::max(),
-                            "Tried to allocate memory over 4GB");
-    } else if constexpr (sizeof(size_t) != 8) {
-      // Double check we are on a 64-bit platform
-      // Note for static checks we need to have some dependence on T, so adding
-      // a dummy
-      constexpr bool dummy = sizeof(T) >= 0;
-      rlbox_detail_static_fail_because(dummy && sizeof(size_t) != 8,
-                                       "Expected 32 or 64 bit platform.");
-    }
-    auto ptr_in_sandbox = this->impl_malloc_in_sandbox(total_size);
-    auto ptr = get_unsandboxed_pointer<T*>(ptr_in_sandbox);
+    auto ptr = malloc_in_sandbox_range<T>(total_size);
     if (!ptr) {
       return tainted<T*, T_Sbx>(nullptr);
     }
-    detail::dynamic_check(is_pointer_in_sandbox_memory(ptr),
-                          "Malloc returned pointer outside the sandbox memory");
+    return tainted<T*, T_Sbx>::internal_factory(ptr);
+  }
 
-    auto ptr_end = checked_add(reinterpret_cast<uintptr_t>(ptr),
-                               reinterpret_cast<uintptr_t>(total_size - 1),
-                               "Malloc object end too large");
-    detail::dynamic_check(
-      is_pointer_in_sandbox_memory(reinterpret_cast<const char*>(ptr_end)),
-      "Malloc returned a pointer whose range goes beyond sandbox memory");
-    auto cast_ptr = reinterpret_cast<T*>(ptr);
-    return tainted<T*, T_Sbx>::internal_factory(cast_ptr);
+  /**
+   * @brief Allocate several arrays that are accessible to both the application
+   * and sandbox, with a single allocation in sandbox memory.
+   *
+   * @tparam T_Types The types of the elements of each array.
+   *
+   * @param counts The number of elements of each array.
+   *
+   * @return std::tuple<tainted<T_Types*, T_Sbx>...> Tainted pointers to the
+   * arrays, which are all null if the allocation fails. The arrays must be
+   * freed together with free_in_sandbox_batch.
+   */
+  template<typename... T_Types>
+  inline std::tuple<tainted<T_Types*, T_Sbx>...> malloc_in_sandbox_batch(
+    std::conditional_t<true, uint32_t, T_Types>... counts)
+  {
+    static_assert(sizeof...(T_Types) != 0,
+                  "malloc_in_sandbox_batch needs at least one type");
+
+    // Silently swallowing the failure is better here as RAII types may try to
+    // malloc after sandbox destruction
+    if (sandbox_created.load() != Sandbox_Status::CREATED) {
+      return std::make_tuple(tainted<T_Types*, T_Sbx>(nullptr)...);
+    }
+
+    // Lay the arrays out one after the other, each aligned for its type
+    const uint32_t el_counts[] = { counts... };
+    constexpr size_t el_sizes[] = { sizeof(T_Types)... };
+    constexpr size_t el_aligns[] = { alignof(T_Types)... };
+    size_t offsets[sizeof...(T_Types)];
+    size_t total_size = 0;
+    for (size_t i = 0; i < sizeof...(T_Types); i++) {
+      detail::dynamic_check(el_counts[i] != 0,
+                            "Malloc tried to allocate 0 bytes");
+      total_size = checked_add(
+        total_size, el_aligns[i] - 1, "Malloc object size too large");
+      total_size &= ~(el_aligns[i] - 1);
+      offsets[i] = total_size;
+      const size_t size =
+        checked_multiply(static_cast<size_t>(el_counts[i]),
+                         el_sizes[i],
+                         "Malloc object size too large");
+      total_size =
+        checked_add(total_size, size, "Malloc object size too large");
+    }
+
+    auto ptr = malloc_in_sandbox_range<char>(total_size);
+    return make_batch_tuple<T_Types...>(
+      ptr, offsets, std::index_sequence_for<T_Types...>());
+  }
+
+  /**
+   * @brief Allocate several arrays of the same type that are accessible to
+   * both the application and sandbox, with a single allocation in sandbox
+   * memory. This is malloc_in_sandbox_batch with the type repeated.
+   *
+   * @tparam T The type of the array elements.
+   *
+   * @param counts The number of elements of each array.
+   *
+   * @return std::tuple<tainted<T*, T_Sbx>...> Tainted pointers to the arrays,
+   * which must be freed together with free_in_sandbox_batch.
+   */
+  template<typename T, typename... T_Counts>
+  inline auto malloc_in_sandbox_many(T_Counts... counts)
+  {
+    static_assert((std::is_integral_v<T_Counts> && ...),
+                  "malloc_in_sandbox_many expects integer counts");
+    detail::dynamic_check((detail::fits_in_integer<uint32_t>(counts) && ...),
+                          "Malloc count too large");
+    return malloc_in_sandbox_batch<std::conditional_t<true, T, T_Counts>...>(
+      static_cast<uint32_t>(counts)...);
   }
 
   /**
@@ -638,6 +894,20 @@ public:
     free_in_sandbox(ptr);
   }
 
+  /**
+   * @brief Free arrays allocated by malloc_in_sandbox_batch or
+   * malloc_in_sandbox_many.
+   *
+   * @param ptrs The tuple of pointers returned by the allocation.
+   */
+  template<typename T, typename... T_Rest>
+  inline void free_in_sandbox_batch(
+    const std::tuple<tainted<T*, T_Sbx>, tainted<T_Rest*, T_Sbx>...>& ptrs)
+  {
+    // The first array is at the start of the allocation
+    free_in_sandbox(std::get<0>(ptrs));
+  }
+
   /**
    * @brief Check if two pointers are in the same sandbox.
    * For the null-sandbox, this always returns true.
@@ -653,6 +923,46 @@ public:
     }
   }
 
+  /**
+   * @brief Get the number of bytes from a pointer in sandbox memory to the end
+   * of that sandbox's memory.
+   *
+   * @return The number of bytes, or the largest size_t if the end isn't known,
+   * such as for the null-sandbox, whose memory isn't a single range.
+   */
+  static inline size_t get_memory_remaining_no_ctx(const void* p)
+  {
+    if (!sandbox_list.has_ranges()) {
+      return std::numeric_limits<size_t>::max();
+    }
+    rlbox_sandbox<T_Sbx>* sandbox = sandbox_list.find(p);
+    if (sandbox == nullptr) {
+      return std::numeric_limits<size_t>::max();
+    }
+    return sandbox->get_memory_remaining(p);
+  }
+
+  /**
+   * @brief Get the number of bytes from a pointer in this sandbox's memory to
+   * the end of its memory.
+   *
+   * @return The number of bytes, or the largest size_t if the pointer isn't in
+   * this sandbox's memory or the end isn't known, such as for the
+   * null-sandbox, whose memory isn't a single range.
+   */
+  inline size_t get_memory_remaining(const void* p)
+  {
+    const size_t unknown = std::numeric_limits<size_t>::max();
+    auto start = reinterpret_cast<uintptr_t>(get_memory_location());
+    size_t size = get_total_memory();
+    auto val = reinterpret_cast<uintptr_t>(p);
+    if (start == 0 || start + size < start || val < start ||
+        val >= start + size) {
+      return unknown;
+    }
+    return start + size - val;
+  }
+
   /**
    * @brief Check if the pointer points to this sandbox's memory.
    * For the null-sandbox, this always returns true.
@@ -721,44 +1031,53 @@ public:
 
   void* lookup_symbol(const char* func_name)
   {
-    {
-      RLBOX_ACQUIRE_SHARED_GUARD(lock, func_ptr_cache_lock);
-
-      auto func_ptr_ref = func_ptr_map.find(func_name);
-      if (func_ptr_ref != func_ptr_map.end()) {
-        return func_ptr_ref->second;
-      }
+    void* func_ptr = nullptr;
+    if (func_ptr_cache.find(func_name, func_ptr)) {
+      return func_ptr;
     }
 
-    void* func_ptr = this->impl_lookup_symbol(func_name);
-    RLBOX_ACQUIRE_UNIQUE_GUARD(lock, func_ptr_cache_lock);
-    func_ptr_map[func_name] = func_ptr;
+    func_ptr = this->impl_lookup_symbol(func_name);
+    func_ptr_cache.insert(func_name, func_ptr);
     return func_ptr;
   }
 
   void* internal_lookup_symbol(const char* func_name)
   {
-    {
-      RLBOX_ACQUIRE_SHARED_GUARD(lock, func_ptr_cache_lock);
-
-      auto func_ptr_ref = func_ptr_map.find(func_name);
-      if (func_ptr_ref != func_ptr_map.end()) {
-        return func_ptr_ref->second;
-      }
+    void* func_ptr = nullptr;
+    if (func_ptr_cache.find(func_name, func_ptr)) {
+      return func_ptr;
     }
 
-    void* func_ptr = 0;
     if constexpr (rlbox::detail::
                     has_member_using_needs_internal_lookup_symbol_v<T_Sbx>) {
       func_ptr = this->impl_internal_lookup_symbol(func_name);
     } else {
       func_ptr = this->impl_lookup_symbol(func_name);
     }
-    RLBOX_ACQUIRE_UNIQUE_GUARD(lock, func_ptr_cache_lock);
-    func_ptr_map[func_name] = func_ptr;
+    func_ptr_cache.insert(func_name, func_ptr);
     return func_ptr;
   }
 
+  /**
+   * @brief Look up the given sandboxed functions in one pass and add them to
+   * the symbol cache, so that the first invocation of each function does not
+   * pay for the lookup. This should be called after create_sandbox. When
+   * RLBOX_USE_STATIC_CALLS is set, there is nothing to look up and this does
+   * nothing.
+   *
+   * @param func_names The names of the functions to look up.
+   */
+  inline void prebind_symbols(std::initializer_list<const char*> func_names)
+  {
+#ifndef RLBOX_USE_STATIC_CALLS
+    for (const char* func_name : func_names) {
+      lookup_symbol(func_name);
+    }
+#else
+    RLBOX_UNUSED(func_names);
+#endif
+  }
+
   // this is an internal function invoked from macros, so it has be public
   template<typename T, typename... T_Args>
   inline auto INTERNAL_invoke_with_func_name(const char* func_name,
@@ -781,16 +1100,13 @@ public:
     // unused in some paths
     RLBOX_UNUSED(func_name);
 #ifdef RLBOX_MEASURE_TRANSITION_TIMES
-    auto enter_time = high_resolution_clock::now();
+    rlbox::detail::transition_timer<rlbox_transition::INVOKE> timer;
     auto on_exit = rlbox::detail::make_scope_exit([&] {
-      auto exit_time = high_resolution_clock::now();
-      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
-      {
-#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
-        RLBOX_ACQUIRE_UNIQUE_GUARD(transition_times_lock);
-#  endif
-        transition_times.push_back(rlbox_transition_timing{
-          rlbox_transition::INVOKE, func_name, func_ptr, ns });
+      if (timer.is_sampled()) {
+        transition_times.record(rlbox_transition::INVOKE,
+                                func_name,
+                                func_ptr,
+                                timer.get_elapsed_ns());
       }
     });
 #endif
@@ -804,43 +1120,93 @@ public:
         rlbox_transition::INVOKE, func_name, func_ptr, transition_state);
     });
 #endif
-    (check_invoke_param_type_is_ok<T_Args>(), ...);
-
-    static_assert(
-      rlbox::detail::polyfill::is_invocable_v<
-        T,
-        detail::rlbox_remove_wrapper_t<std::remove_reference_t<T_Args>>...>,
-      "Mismatched arguments types for function");
-
-    using T_Result = rlbox::detail::polyfill::invoke_result_t<
-      T,
-      detail::rlbox_remove_wrapper_t<std::remove_reference_t<T_Args>>...>;
+    return invoke_with_func_ptr_no_transition<T, false /* in batch */>(
+      func_ptr, std::forward<T_Args>(params)...);
+  }
 
-    using T_Converted =
-      std::remove_pointer_t<convert_fn_ptr_to_sandbox_equivalent_t<T*>>;
+  /**
+   * @brief Call several sandbox functions as a single transition. Transition
+   * hooks and timers run once for the whole batch. Sandbox plugins that
+   * declare `using can_invoke_batch = void;` also enter the sandbox once for
+   * the whole batch via impl_invoke_batch.
+   *
+   * @param calls The calls to make in order. These are created with
+   * bind_sandbox_function or sandbox_function::bind.
+   * @return A tuple with the tainted result of each call. Calls that return
+   * void produce a std::monostate.
+   */
+  template<typename... T_Calls>
+  inline auto invoke_sandbox_batch(const T_Calls&... calls)
+  {
+    static_assert(sizeof...(T_Calls) > 0,
+                  "invoke_sandbox_batch expects at least one call");
+
+    // Batches don't have a single function name or pointer, so use this
+    // string's address as the key for transition hooks and timing
+    static const char batch_name[] = "invoke_sandbox_batch";
+    void* batch_ptr = const_cast<char*>(batch_name);
+    RLBOX_UNUSED(batch_ptr);
+#ifdef RLBOX_MEASURE_TRANSITION_TIMES
+    rlbox::detail::transition_timer<rlbox_transition::INVOKE> timer;
+    auto on_exit = rlbox::detail::make_scope_exit([&] {
+      if (timer.is_sampled()) {
+        transition_times.record(rlbox_transition::INVOKE,
+                                batch_name,
+                                batch_ptr,
+                                timer.get_elapsed_ns());
+      }
+    });
+#endif
+#ifdef RLBOX_TRANSITION_ACTION_IN
+    RLBOX_TRANSITION_ACTION_IN(
+      rlbox_transition::INVOKE, batch_name, batch_ptr, transition_state);
+#endif
+#ifdef RLBOX_TRANSITION_ACTION_OUT
+    auto on_exit_transition = rlbox::detail::make_scope_exit([&] {
+      RLBOX_TRANSITION_ACTION_OUT(
+        rlbox_transition::INVOKE, batch_name, batch_ptr, transition_state);
+    });
+#endif
 
-    if constexpr (std::is_void_v<T_Result>) {
-      this->template impl_invoke_with_func_ptr<T>(
-        reinterpret_cast<T_Converted*>(func_ptr),
-        invoke_process_param(params)...);
-      return;
+    constexpr bool in_batch =
+      detail::has_member_using_can_invoke_batch_v<T_Sbx>;
+    // The braced initializer ensures the calls are made in order
+    auto run_calls = [&]() {
+      return std::tuple<decltype(invoke_batch_call<in_batch>(calls))...>{
+        invoke_batch_call<in_batch>(calls)...
+      };
+    };
+
+    if constexpr (in_batch) {
+      return this->impl_invoke_batch(run_calls);
     } else {
-      auto raw_result = this->template impl_invoke_with_func_ptr<T>(
-        reinterpret_cast<T_Converted*>(func_ptr),
-        invoke_process_param(params)...);
-      tainted<T_Result, T_Sbx> wrapped_result;
-      using namespace detail;
-      convert_type<T_Sbx,
-                   adjust_type_direction::TO_APPLICATION,
-                   adjust_type_context::SANDBOX>(
-        wrapped_result.get_raw_value_ref(),
-        raw_result,
-        nullptr /* example_unsandboxed_ptr */,
-        this /* sandbox_ptr */);
-      return wrapped_result;
+      return run_calls();
     }
   }
 
+  // this is an internal function invoked from macros, so it has be public
+  template<typename T, typename... T_Args>
+  inline auto INTERNAL_invoke_async(
+    sandbox_function_call<T, T_Sbx, T_Args...> call)
+  {
+    detail::dynamic_check(call.func.sandbox == this,
+                          "invoke_sandbox_function_async called with a "
+                          "function from a different sandbox");
+    // An incomplete type error here means rlbox_sandbox_worker.hpp should be
+    // included
+    return detail::sandbox_async_invoker<T_Sbx>::submit(
+      async_worker, [this, call = std::move(call)]() mutable {
+        return std::apply(
+          [&](T_Args&... params) {
+            return INTERNAL_invoke_with_func_ptr<T>(
+              call.func.func_name,
+              call.func.func_ptr,
+              sandbox_function_call_detail::unwrap(params)...);
+          },
+          call.params);
+      });
+  }
+
   // Useful in the porting stage to temporarily allow non tainted pointers to go
   // through. This will only ever work in the rlbox_noop_sandbox. Any sandbox
   // that actually enforces isolation will crash here.
@@ -858,8 +1224,10 @@ public:
   using T_Cb_no_wrap = detail::rlbox_remove_wrapper_t<T_Ret>(
     detail::rlbox_remove_wrapper_t<T_Args>...);
 
-  template<typename T_Ret>
-  sandbox_callback<T_Cb_no_wrap<T_Ret>*, T_Sbx> register_callback(T_Ret (*)())
+private:
+  template<bool T_AddKey, typename T_Ret>
+  sandbox_callback<T_Cb_no_wrap<T_Ret>*, T_Sbx> register_callback_impl(
+    T_Ret (*)())
   {
     rlbox_detail_static_fail_because(
       detail::true_v<T_Ret>,
@@ -873,21 +1241,10 @@ public:
     std::abort();
   }
 
-  /**
-   * @brief Expose a callback function to the sandboxed code.
-   *
-   * @param func_ptr The callback to expose.
-   *
-   * @tparam T_RL   Sandbox reference type (first argument).
-   * @tparam T_Ret  Return type of callback. Must be tainted or void.
-   * @tparam T_Args Types of remaining callback arguments. Must be tainted.
-   *
-   * @return Wrapped callback function pointer that can be passed to the
-   * sandbox.
-   */
-  template<typename T_RL, typename T_Ret, typename... T_Args>
-  sandbox_callback<T_Cb_no_wrap<T_Ret, T_Args...>*, T_Sbx> register_callback(
-    T_Ret (*func_ptr)(T_RL, T_Args...))
+  // T_AddKey is false if the caller has already added the callback's key
+  template<bool T_AddKey, typename T_RL, typename T_Ret, typename... T_Args>
+  sandbox_callback<T_Cb_no_wrap<T_Ret, T_Args...>*, T_Sbx>
+  register_callback_impl(T_Ret (*func_ptr)(T_RL, T_Args...))
   {
     // Some branches don't use the param
     RLBOX_UNUSED(func_ptr);
@@ -954,14 +1311,11 @@ public:
       // Make sure that the user hasn't previously registered this function...
       // If they have, we would returning 2 owning types (sandbox_callback) to
       // the same callback which would be bad
-      {
+      if constexpr (T_AddKey) {
         std::lock_guard<std::mutex> lock(callback_lock);
-        bool exists =
-          std::find(callback_keys.begin(), callback_keys.end(), unique_key) !=
-          callback_keys.end();
+        bool added = callback_keys.insert(unique_key);
         detail::dynamic_check(
-          !exists, "You have previously already registered this callback.");
-        callback_keys.push_back(unique_key);
+          added, "You have previously already registered this callback.");
       }
 
       auto callback_interceptor =
@@ -991,6 +1345,90 @@ public:
     }
   }
 
+public:
+  /**
+   * @brief Expose a callback function to the sandboxed code.
+   *
+   * @param func_ptr The callback to expose.
+   *
+   * @tparam T_RL   Sandbox reference type (first argument).
+   * @tparam T_Ret  Return type of callback. Must be tainted or void.
+   * @tparam T_Args Types of remaining callback arguments. Must be tainted.
+   *
+   * @return Wrapped callback function pointer that can be passed to the
+   * sandbox.
+   */
+  template<typename T_RL, typename T_Ret, typename... T_Args>
+  sandbox_callback<T_Cb_no_wrap<T_Ret, T_Args...>*, T_Sbx> register_callback(
+    T_Ret (*func_ptr)(T_RL, T_Args...))
+  {
+    return register_callback_impl<true>(func_ptr);
+  }
+
+  template<typename T_Ret>
+  sandbox_callback<T_Cb_no_wrap<T_Ret>*, T_Sbx> register_callback(
+    T_Ret (*func_ptr)())
+  {
+    return register_callback_impl<true>(func_ptr);
+  }
+
+  /**
+   * @brief Expose several callback functions to the sandboxed code. This is
+   * the same as calling register_callback on each, except that the callbacks
+   * are checked and recorded under a single lock acquisition. If any of the
+   * callbacks was already registered, or registering one of them fails, none
+   * of them are registered.
+   *
+   * @param func_ptrs The callbacks to expose.
+   *
+   * @return A std::tuple with the wrapped callback of each function, in order.
+   */
+  template<typename... T_Funcs>
+  inline auto register_callbacks(T_Funcs*... func_ptrs)
+  {
+    detail::dynamic_check(sandbox_created.load() == Sandbox_Status::CREATED,
+                          "register_callbacks called without sandbox creation");
+
+    const void* keys[] = { reinterpret_cast<const void*>(func_ptrs)...,
+                           nullptr };
+    const size_t count = sizeof...(T_Funcs);
+    {
+      std::lock_guard<std::mutex> lock(callback_lock);
+      for (size_t i = 0; i < count; i++) {
+        if (!callback_keys.insert(keys[i])) {
+          for (size_t j = 0; j < i; j++) {
+            callback_keys.erase(keys[j]);
+          }
+          detail::dynamic_check(
+            false, "You have previously already registered this callback.");
+        }
+      }
+    }
+
+    // A registered callback releases its key when it is destroyed, but if a
+    // registration fails, the keys of the callbacks after it are still ours
+    // to release
+    size_t registered = 0;
+    auto on_failure = detail::make_scope_exit([&] {
+      std::lock_guard<std::mutex> lock(callback_lock);
+      for (size_t i = registered; i < count; i++) {
+        callback_keys.erase(keys[i]);
+      }
+    });
+    auto register_next = [&](auto func_ptr) {
+      auto ret = register_callback_impl<false>(func_ptr);
+      registered++;
+      return ret;
+    };
+
+    // Braced initialization evaluates in order
+    std::tuple<decltype(register_callback_impl<false>(func_ptrs))...> ret{
+      register_next(func_ptrs)...
+    };
+    on_failure.release();
+    return ret;
+  }
+
   // this is an internal function invoked from macros, so it has be public
   template<typename T>
   inline tainted<T*, T_Sbx> INTERNAL_get_sandbox_function_name(
@@ -1007,6 +1445,24 @@ public:
     return tainted<T*, T_Sbx>::internal_factory(reinterpret_cast<T*>(func_ptr));
   }
 
+  // this is an internal function invoked from macros, so it has be public
+  template<typename T>
+  inline sandbox_function<T, T_Sbx> INTERNAL_get_sandbox_function_handle_name(
+    const char* func_name)
+  {
+    return INTERNAL_get_sandbox_function_handle_ptr<T>(func_name,
+                                                       lookup_symbol(func_name));
+  }
+
+  // this is an internal function invoked from macros, so it has be public
+  template<typename T>
+  inline sandbox_function<T, T_Sbx> INTERNAL_get_sandbox_function_handle_ptr(
+    const char* func_name,
+    void* func_ptr)
+  {
+    return sandbox_function<T, T_Sbx>(this, func_name, func_ptr);
+  }
+
   /**
    * @brief Create a "fake" pointer referring to a location in the application
    * memory
@@ -1057,33 +1513,53 @@ public:
   }
 
 #ifdef RLBOX_MEASURE_TRANSITION_TIMES
+  /**
+   * @brief Get the transition timings recorded so far. If
+   * RLBOX_TRANSITION_TIMES_RING_SIZE is defined, this first merges the records
+   * buffered in each thread's ring. If RLBOX_TRANSITION_TIMES_SAMPLE_RATE is
+   * defined, this only includes the sampled transitions. If
+   * RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS is defined, this is empty unless
+   * RLBOX_TRANSITION_TIMES_KEEP_RECORDS is also defined.
+   */
   inline std::vector<rlbox_transition_timing>&
   process_and_get_transition_times()
   {
-    return transition_times;
+    return transition_times.process_and_get();
   }
   inline int64_t get_total_ns_time_in_sandbox_and_transitions()
   {
-#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
-    RLBOX_ACQUIRE_SHARED_GUARD(transition_times_lock);
-#  endif
-    int64_t ret = 0;
-    for (auto& transition_time : transition_times) {
-      if (transition_time.invoke == rlbox_transition::INVOKE) {
-        ret += transition_time.time;
-      } else {
-        ret -= transition_time.time;
-      }
-    }
-    return ret;
+    return transition_times.get_total_ns_time();
+  }
+  inline void clear_transition_times() { transition_times.clear(); }
+  /**
+   * @brief Get the number of transition timings dropped because a thread's
+   * ring was full or RLBOX_TRANSITION_TIMES_MAX_RECORDS timings were already
+   * merged, since the last call to clear_transition_times.
+   */
+  inline uint64_t get_dropped_transition_times_count()
+  {
+    return transition_times.get_dropped();
   }
-  inline void clear_transition_times()
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+  /**
+   * @brief Get the latency summary (count, p50, p99, max) of each sandboxed
+   * function invoked and each callback called since the last call to
+   * clear_transition_times.
+   */
+  inline std::vector<rlbox_transition_latency_stats>
+  get_transition_latency_stats()
   {
-#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
-    RLBOX_ACQUIRE_UNIQUE_GUARD(transition_times_lock);
-#  endif
-    transition_times.clear();
+    return transition_times.get_latency_stats();
   }
+  /**
+   * @brief Get the number of transitions that were not added to any latency
+   * histogram as all RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS were in use.
+   */
+  inline uint64_t get_untracked_transition_latency_count()
+  {
+    return transition_times.get_untracked_latency_count();
+  }
+#  endif
 #endif
 };
 
@@ -1100,6 +1576,15 @@ public:
 // Don't know the compiler... just let it go through
 #endif
 
+/**
+ * @def  get_sandbox_function
+ * @brief Look up a sandbox function once and return a sandbox_function handle
+ * that can be used to call it repeatedly without further lookups.
+ *
+ * @param func_name The sandboxed library function to look up.
+ * @return A sandbox_function handle.
+ */
+
 /**
  * @def  invoke_sandbox_function
  * @brief Call sandbox function.
@@ -1122,6 +1607,11 @@ public:
     template INTERNAL_get_sandbox_function_ptr<decltype(func_name)>(           \
       sandbox_lookup_symbol_helper(RLBOX_USE_STATIC_CALLS(), func_name))
 
+#  define get_sandbox_function(func_name)                                      \
+    template INTERNAL_get_sandbox_function_handle_ptr<decltype(func_name)>(    \
+      #func_name,                                                              \
+      sandbox_lookup_symbol_helper(RLBOX_USE_STATIC_CALLS(), func_name))
+
 #else
 
 #  define invoke_sandbox_function(func_name, ...)                              \
@@ -1131,8 +1621,54 @@ public:
 #  define get_sandbox_function_address(func_name)                              \
     template INTERNAL_get_sandbox_function_name<decltype(func_name)>(#func_name)
 
+#  define get_sandbox_function(func_name)                                      \
+    template INTERNAL_get_sandbox_function_handle_name<decltype(func_name)>(   \
+      #func_name)
+
 #endif
 
+/**
+ * @def  prebind_sandbox_functions
+ * @brief Look up the given sandbox functions and add them to the symbol cache
+ * before they are first invoked. See rlbox_sandbox::prebind_symbols.
+ *
+ * @param ... The sandboxed library functions to look up, at most 16.
+ */
+#define prebind_sandbox_functions(...)                                         \
+  prebind_symbols(                                                             \
+    { RLBOX_PP_FOR_EACH(rlbox_detail_prebind_function_name, __VA_ARGS__) })
+
+#define rlbox_detail_prebind_function_name(func_name)                          \
+  ::rlbox::detail::prebind_function_name<decltype(func_name)>(#func_name)
+
+/**
+ * @def  bind_sandbox_function
+ * @brief Look up a sandbox function and bind arguments to it without calling
+ * it. The result can be passed to rlbox_sandbox::invoke_sandbox_batch.
+ *
+ * @param func_name The sandboxed library function to call.
+ * @param ... Arguments to function should be simple or tainted values.
+ */
+#define bind_sandbox_function(func_name, ...)                                  \
+  get_sandbox_function(func_name).bind(__VA_ARGS__)
+
+/**
+ * @def  invoke_sandbox_function_async
+ * @brief Call sandbox function on a worker thread owned by the sandbox. Calls
+ * are made one at a time in the order they are queued, with the usual
+ * transition hooks and timers. Callbacks invoked by the function run on the
+ * worker thread. The sandbox's destroy_sandbox waits for queued calls to
+ * finish. This requires including rlbox_sandbox_worker.hpp.
+ *
+ * @param func_name The sandboxed library function to call.
+ * @param ... Arguments to function should be simple or tainted values. These
+ * are copied, except for callbacks which are referenced. Callbacks must be
+ * lvalues that remain registered until the call completes.
+ * @return A std::future holding the tainted result.
+ */
+#define invoke_sandbox_function_async(func_name, ...)                          \
+  get_sandbox_function(func_name).invoke_async(__VA_ARGS__)
+
 #define sandbox_invoke(sandbox, func_name, ...)                                \
   (sandbox).invoke_sandbox_function(func_name, ##__VA_ARGS__)
 
@@ -0,0 +1,280 @@
+#pragma once
+// IWYU pragma: private, include "rlbox.hpp"
+// IWYU pragma: friend "rlbox_.*\.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "rlbox_helpers.hpp"
+#include "rlbox_types.hpp"
+
+// The size of the scratch region in sandbox memory that each thread gets for
+// its sandbox_frames, in each sandbox it makes frames for
+#ifndef RLBOX_SANDBOX_SCRATCH_SIZE
+#  define RLBOX_SANDBOX_SCRATCH_SIZE (16 * 1024)
+#endif
+
+namespace rlbox::detail {
+
+/**
+ * @brief The per-thread scratch regions of a sandbox. Each thread that makes
+ * a sandbox_frame gets its own region, so frames don't need locks. When a
+ * thread exits, its regions are handed to the next thread of each sandbox
+ * that needs one, so a sandbox has no more regions than the most threads that
+ * used it at once. Regions are freed when clear is called, when the sandbox
+ * is destroyed.
+ */
+class scratch_regions
+{
+public:
+  struct region
+  {
+    region* next;
+    // Null if the sandbox memory for the region hasn't been allocated
+    char* start = nullptr;
+    size_t size = 0;
+    size_t used = 0;
+    // The innermost live frame on this region
+    const void* top_frame = nullptr;
+    // Set when the owning thread exits, so that another thread can take the
+    // region
+    std::atomic<bool> available{ false };
+    // Set when the region is removed from its sandbox by clear
+    std::atomic<bool> cleared{ false };
+    // Held by the sandbox's list of regions and by the owning thread
+    std::atomic<uint32_t> references{ 2 };
+
+    explicit region(region* p_next)
+      : next(p_next)
+    {}
+  };
+
+private:
+  struct thread_region
+  {
+    uint64_t regions_id;
+    region* curr;
+  };
+
+  // The regions of a thread, most recently used first, which are released
+  // when the thread exits
+  struct thread_regions
+  {
+    std::vector<thread_region> entries;
+
+    // Not defaulted, as GCC rejects the thread_local member below otherwise
+    thread_regions() {}
+    thread_regions(const thread_regions&) = delete;
+    thread_regions& operator=(const thread_regions&) = delete;
+
+    ~thread_regions()
+    {
+      for (auto& entry : entries) {
+        entry.curr->available.store(true, std::memory_order_release);
+        release(entry.curr);
+      }
+    }
+  };
+
+  static inline std::atomic<uint64_t> next_regions_id{ 1 };
+  // Ids are never reused, so a thread's cached region can never be mistaken
+  // for a region of another sandbox, or one from before a clear
+  thread_local static inline thread_regions thread_cache;
+
+  std::atomic<uint64_t> regions_id{ next_regions_id.fetch_add(1) };
+  std::atomic<region*> regions{ nullptr };
+
+  static inline void release(region* curr)
+  {
+    if (curr->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete curr;
+    }
+  }
+
+  region* take_or_create_region()
+  {
+    auto head = regions.load(std::memory_order_acquire);
+    for (auto curr = head; curr != nullptr; curr = curr->next) {
+      bool expected = true;
+      if (curr->available.load(std::memory_order_relaxed) &&
+          curr->available.compare_exchange_strong(
+            expected, false, std::memory_order_acquire)) {
+        curr->references.fetch_add(1, std::memory_order_relaxed);
+        return curr;
+      }
+    }
+
+    auto curr = new region(head);
+    while (!regions.compare_exchange_weak(curr->next,
+                                          curr,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+    return curr;
+  }
+
+  region* find_thread_region(uint64_t id)
+  {
+    auto& entries = thread_cache.entries;
+    for (size_t i = 1; i < entries.size(); i++) {
+      if (entries[i].regions_id == id) {
+        std::swap(entries[0], entries[i]);
+        return entries[0].curr;
+      }
+    }
+
+    // Drop the regions of destroyed sandboxes before adding a new one
+    auto stale = std::remove_if(
+      entries.begin(), entries.end(), [](const thread_region& entry) {
+        if (!entry.curr->cleared.load(std::memory_order_acquire)) {
+          return false;
+        }
+        release(entry.curr);
+        return true;
+      });
+    entries.erase(stale, entries.end());
+
+    auto curr = take_or_create_region();
+    entries.insert(entries.begin(), thread_region{ id, curr });
+    return curr;
+  }
+
+public:
+  scratch_regions() = default;
+  scratch_regions(const scratch_regions&) = delete;
+  scratch_regions& operator=(const scratch_regions&) = delete;
+
+  ~scratch_regions()
+  {
+    clear([](char*) {});
+  }
+
+  inline region* get_thread_region()
+  {
+    auto id = regions_id.load(std::memory_order_relaxed);
+    auto& entries = thread_cache.entries;
+    if (!entries.empty() && entries[0].regions_id == id) {
+      return entries[0].curr;
+    }
+    return find_thread_region(id);
+  }
+
+  /**
+   * @brief Remove every region, calling free_memory on the sandbox memory of
+   * each region that has any. This must not race with frames using the
+   * regions.
+   */
+  template<typename T_Func>
+  inline void clear(T_Func&& free_memory)
+  {
+    regions_id.store(next_regions_id.fetch_add(1), std::memory_order_relaxed);
+    auto curr = regions.exchange(nullptr, std::memory_order_acq_rel);
+    while (curr != nullptr) {
+      if (curr->start != nullptr) {
+        free_memory(curr->start);
+      }
+      auto next = curr->next;
+      curr->cleared.store(true, std::memory_order_release);
+      release(curr);
+      curr = next;
+    }
+  }
+};
+
+}
+
+namespace rlbox {
+
+/**
+ * @brief A scope for temporary allocations in sandbox memory, such as the
+ * out-parameters and small structs passed to a sandbox function. Allocations
+ * are carved from a scratch region that the current thread has in the
+ * sandbox's memory, and all of them are released when the frame is destroyed,
+ * so they cost about as much as alloca.
+ *
+ * Frames on a thread nest like stack frames, and only the innermost frame may
+ * allocate. Allocations that don't fit in the scratch region fall back to
+ * malloc_in_sandbox and are freed with the frame. Allocations are not
+ * initialized. Frames must be destroyed on the thread that created them, and
+ * before the sandbox is destroyed.
+ *
+ * @tparam T_Sbx Type of sandbox. For the null sandbox this is
+ * `rlbox_noop_sandbox`
+ */
+template<typename T_Sbx>
+class sandbox_frame
+{
+  rlbox_sandbox<T_Sbx>& sandbox;
+  detail::scratch_regions::region* region;
+  size_t saved_used;
+  const void* saved_top_frame;
+  // Allocations that didn't fit in the scratch region
+  std::vector<char*> overflow;
+
+public:
+  explicit sandbox_frame(rlbox_sandbox<T_Sbx>& p_sandbox)
+    : sandbox(p_sandbox)
+    , region(p_sandbox.get_thread_scratch_region())
+    , saved_used(region->used)
+    , saved_top_frame(region->top_frame)
+  {
+    region->top_frame = this;
+  }
+
+  sandbox_frame(const sandbox_frame&) = delete;
+  sandbox_frame& operator=(const sandbox_frame&) = delete;
+
+  ~sandbox_frame()
+  {
+    region->used = saved_used;
+    region->top_frame = saved_top_frame;
+    for (auto p : overflow) {
+      sandbox.free_in_sandbox(tainted<char*, T_Sbx>::internal_factory(p));
+    }
+  }
+
+  /**
+   * @brief Allocate an array in sandbox memory that lives until the frame is
+   * destroyed.
+   *
+   * @tparam T The type of the array elements.
+   * @param count The number of array elements to allocate.
+   * @return The allocation, or null if the sandbox is out of memory.
+   */
+  template<typename T>
+  inline tainted<T*, T_Sbx> malloc_in_sandbox(uint32_t count = 1)
+  {
+    detail::dynamic_check(region->top_frame == this,
+                          "Allocated from a sandbox_frame that is not the "
+                          "innermost frame of the thread");
+    detail::dynamic_check(count != 0, "Malloc tried to allocate 0 bytes");
+
+    if (region->start != nullptr) {
+      auto base = reinterpret_cast<uintptr_t>(region->start);
+      constexpr auto align = static_cast<uintptr_t>(alignof(T));
+      auto offset = static_cast<size_t>(
+        ((base + region->used + align - 1) & ~(align - 1)) - base);
+      if (offset <= region->size &&
+          count <= (region->size - offset) / sizeof(T)) {
+        region->used = offset + count * sizeof(T);
+        // The whole region was bounds checked when it was allocated
+        auto ret = reinterpret_cast<T*>(region->start + offset);
+        return tainted<T*, T_Sbx>::internal_factory(ret);
+      }
+    }
+
+    auto ret = sandbox.template malloc_in_sandbox<T>(count);
+    if (ret != nullptr) {
+      overflow.push_back(reinterpret_cast<char*>(
+        const_cast<std::remove_const_t<T>*>(ret.UNSAFE_unverified())));
+    }
+    return ret;
+  }
+};
+
+}
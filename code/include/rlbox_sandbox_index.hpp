@@ -0,0 +1,711 @@
+#pragma once
+// IWYU pragma: private, include "rlbox.hpp"
+// IWYU pragma: friend "rlbox_.*\.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#ifndef RLBOX_USE_CUSTOM_SHARED_LOCK
+#  include <shared_mutex>
+#endif
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rlbox_helpers.hpp"
+
+namespace rlbox::detail {
+
+/**
+ * @brief Hazard pointers, which let lock-free readers use objects that writers
+ * may unpublish at any time. A reader protects an object by publishing its
+ * address in its thread's record and checking that the object is still
+ * published. A writer that has unpublished an object waits until no record
+ * holds its address before freeing it.
+ *
+ * Each thread has its own record, so readers never write to memory shared with
+ * other readers. Records are kept in a list that only grows, and a thread's
+ * record is returned for reuse when the thread exits. A record is shared by the
+ * domain and the thread using it, so it is freed by whichever lets go of it
+ * last, and a thread may exit after its domain is destroyed.
+ *
+ * @tparam T_Tag Each tag has its own thread local record cache.
+ */
+template<typename T_Tag>
+class hazard_domain
+{
+public:
+  static constexpr size_t hazards_per_thread = 2;
+
+private:
+  struct record
+  {
+    std::atomic<const void*> hazards[hazards_per_thread] = {};
+    std::atomic<bool> in_use{ true };
+    // Held by the domain's list and by the thread using the record
+    std::atomic<uint32_t> references{ 2 };
+    record* next = nullptr;
+  };
+
+  static inline void release_record(record* rec)
+  {
+    if (rec->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete rec;
+    }
+  }
+
+  static inline std::atomic<uint64_t> next_domain_id{ 1 };
+  // Ids are never reused, so a thread's record can never be mistaken for a
+  // record of a later domain at the same address
+  const uint64_t domain_id = next_domain_id.fetch_add(1);
+  std::atomic<record*> records{ nullptr };
+
+  struct thread_record
+  {
+    uint64_t domain_id = 0;
+    record* rec = nullptr;
+
+    inline void release()
+    {
+      if (rec != nullptr) {
+        for (auto& hazard : rec->hazards) {
+          hazard.store(nullptr, std::memory_order_relaxed);
+        }
+        rec->in_use.store(false, std::memory_order_release);
+        release_record(rec);
+        rec = nullptr;
+      }
+    }
+
+    ~thread_record() { release(); }
+  };
+
+  static inline thread_local thread_record curr_thread_record;
+
+  inline record* acquire_record()
+  {
+    auto head = records.load(std::memory_order_acquire);
+    for (auto rec = head; rec != nullptr; rec = rec->next) {
+      bool expected = false;
+      if (!rec->in_use.load(std::memory_order_relaxed) &&
+          rec->in_use.compare_exchange_strong(expected, true)) {
+        rec->references.fetch_add(1, std::memory_order_relaxed);
+        return rec;
+      }
+    }
+
+    auto rec = new record();
+    rec->next = head;
+    while (!records.compare_exchange_weak(rec->next, rec)) {
+    }
+    return rec;
+  }
+
+  inline record* get_record()
+  {
+    auto& curr = curr_thread_record;
+    if (curr.domain_id != domain_id) {
+      // Only one domain per tag is expected, so switching domains is rare
+      curr.release();
+      curr.rec = acquire_record();
+      curr.domain_id = domain_id;
+    }
+    return curr.rec;
+  }
+
+public:
+  hazard_domain() = default;
+  hazard_domain(const hazard_domain&) = delete;
+  hazard_domain& operator=(const hazard_domain&) = delete;
+
+  ~hazard_domain()
+  {
+    // Records still held by threads are freed when those threads let go of
+    // them
+    auto rec = records.load();
+    while (rec != nullptr) {
+      auto next = rec->next;
+      release_record(rec);
+      rec = next;
+    }
+  }
+
+  /**
+   * @brief Load a published object and protect it from being freed until
+   * clear is called with the same index.
+   */
+  template<typename T>
+  inline T* protect(size_t index, const std::atomic<T*>& src)
+  {
+    auto& hazard = get_record()->hazards[index];
+    T* ret = src.load();
+    while (true) {
+      hazard.store(ret);
+      T* curr = src.load();
+      if (curr == ret) {
+        return ret;
+      }
+      ret = curr;
+    }
+  }
+
+  /**
+   * @brief Protect an object that the caller has to validate itself, after
+   * this returns, by checking that it is still published.
+   */
+  inline void protect_unchecked(size_t index, const void* p)
+  {
+    get_record()->hazards[index].store(p);
+  }
+
+  inline void clear(size_t index)
+  {
+    get_record()->hazards[index].store(nullptr, std::memory_order_release);
+  }
+
+  inline bool is_protected(const void* p)
+  {
+    auto head = records.load(std::memory_order_acquire);
+    for (auto rec = head; rec != nullptr; rec = rec->next) {
+      for (auto& hazard : rec->hazards) {
+        if (hazard.load() == p) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Wait until no reader protects the given object. The object must
+   * already be unpublished.
+   */
+  inline void wait_until_unprotected(const void* p)
+  {
+    while (is_protected(p)) {
+      std::this_thread::yield();
+    }
+  }
+};
+
+/**
+ * @brief The set of live sandboxes of one type, indexed by their memory
+ * ranges so that the sandbox that owns a pointer can be found in O(log n).
+ *
+ * Each sandbox is registered in a slot. Slots are allocated in chunks that are
+ * never moved, and released slots are kept in a free list. Each registration
+ * gets a unique id, which its slot holds until the sandbox is removed.
+ *
+ * The published index has a sorted base and a short list of pending entries.
+ * Registering a sandbox appends an entry to the pending list, and removing one
+ * only clears its slot. Entries refer to a slot and a registration id, and an
+ * entry whose id no longer matches its slot's is stale and skipped. When the
+ * pending list is full, or enough sandboxes have been removed since the last
+ * merge, the registering or removing thread merges the pending entries into a
+ * new sorted base and drops stale entries, so lookups never do this work.
+ *
+ * Lookups don't take locks. They binary search the base for the range that
+ * starts closest below the pointer and then check the pending entries.
+ * Sandboxes that don't report a memory range, such as the noop sandbox, are
+ * kept in a separate list and are checked one at a time. A sandbox's memory may
+ * grow after it is registered, for example through wasm's memory.grow. When a
+ * pointer is past the end of the closest range, that sandbox's current size is
+ * checked, and the slot's range is extended if the sandbox has grown. So a miss
+ * is still O(log n).
+ *
+ * Lookups protect the published index, and any sandbox they call into, with
+ * hazard pointers in a per-thread record, so concurrent lookups don't write to
+ * shared memory. Replaced indexes are retired and freed later, once no lookup
+ * protects them. Removing a sandbox only waits if a lookup is calling into
+ * that sandbox at that moment.
+ *
+ * Consecutive lookups on a thread usually find the same sandbox, so each thread
+ * remembers the last sandbox it found and checks it first. Removing a sandbox
+ * bumps a generation counter, which invalidates the remembered sandbox on
+ * every thread.
+ *
+ * @tparam T_Sandbox The rlbox_sandbox type.
+ */
+template<typename T_Sandbox>
+class sandbox_index
+{
+  struct slot
+  {
+    // The id of the registration in this slot, or zero if it is free
+    std::atomic<uint64_t> id{ 0 };
+    std::atomic<T_Sandbox*> sandbox{ nullptr };
+    // Zero if the sandbox has no memory range
+    std::atomic<uintptr_t> start{ 0 };
+    // The last byte of the sandbox's memory. This only grows while the
+    // sandbox is registered.
+    std::atomic<uintptr_t> last{ 0 };
+  };
+
+  struct range
+  {
+    // Zero if the sandbox has no memory range
+    uintptr_t start;
+    slot* owner;
+    uint64_t id;
+  };
+
+  struct sorted_ranges
+  {
+    // Sorted by start
+    std::vector<range> ranges;
+    // Entries of sandboxes without a memory range
+    std::vector<range> unranged;
+  };
+
+  struct snapshot
+  {
+    std::unique_ptr<const sorted_ranges> base;
+    // Only appended to, with write_lock held. Entries below pending_count
+    // don't change.
+    std::unique_ptr<range[]> pending;
+    size_t pending_capacity;
+    std::atomic<size_t> pending_count{ 0 };
+
+    snapshot(std::unique_ptr<const sorted_ranges> p_base, size_t capacity)
+      : base(std::move(p_base))
+      , pending(new range[capacity])
+      , pending_capacity(capacity)
+    {}
+  };
+
+  // Hazard pointer indices
+  static constexpr size_t snapshot_hazard = 0;
+  static constexpr size_t sandbox_hazard = 1;
+
+  // The index is merged when at most this many entries are pending, or this
+  // many sandboxes have been removed since the last merge
+  static constexpr size_t merge_threshold = 16;
+
+  // Chunk i holds first_chunk_size << i slots
+  static constexpr size_t first_chunk_size = 64;
+  static constexpr size_t max_chunks = 32;
+  slot* chunks[max_chunks] = {};
+
+  std::atomic<snapshot*> current{ nullptr };
+  // Bumped whenever a sandbox is removed
+  std::atomic<uint64_t> generation{ 0 };
+  std::atomic<size_t> ranged_count{ 0 };
+  hazard_domain<T_Sandbox> hazards;
+
+  RLBOX_SHARED_LOCK(write_lock);
+  std::vector<slot*> free_slots;
+  size_t next_chunk = 0;
+  size_t next_offset = 0;
+  uint64_t next_id = 1;
+  // Replaced snapshots that lookups may still be using
+  std::vector<snapshot*> retired;
+  // Sandboxes removed since the last merge, whose entries are stale
+  size_t removed_count = 0;
+
+  static inline std::atomic<uint64_t> next_index_id{ 1 };
+  // Ids are never reused, so a thread's cached hit can never be mistaken for
+  // a hit in a later index at the same address
+  const uint64_t index_id = next_index_id.fetch_add(1);
+
+  struct last_hit
+  {
+    uint64_t index_id = 0;
+    uint64_t generation = 0;
+    T_Sandbox* sandbox = nullptr;
+    // Copied from the slot, so a hit can be checked without touching a
+    // sandbox that may have been destroyed
+    uintptr_t start = 0;
+    uintptr_t last = 0;
+  };
+
+  static inline thread_local last_hit cached;
+
+  static constexpr size_t get_chunk_size(size_t chunk)
+  {
+    return first_chunk_size << chunk;
+  }
+
+  static inline bool compare_start(uintptr_t v, const range& el)
+  {
+    return v < el.start;
+  }
+
+  // Returns false if the sandbox doesn't report a memory range
+  static inline bool get_range(T_Sandbox* sandbox,
+                               uintptr_t& start,
+                               uintptr_t& last)
+  {
+    start = reinterpret_cast<uintptr_t>(sandbox->get_memory_location());
+    size_t size = sandbox->get_total_memory();
+    if (start == 0 || size == 0 || start + (size - 1) < start) {
+      return false;
+    }
+    last = start + (size - 1);
+    return true;
+  }
+
+  static inline bool is_live(const range& el)
+  {
+    return el.owner->id.load(std::memory_order_acquire) == el.id;
+  }
+
+  // Reads the end of the entry's range and its sandbox. Returns false if the
+  // entry is stale.
+  static inline bool read_entry(const range& el,
+                                uintptr_t& last,
+                                T_Sandbox*& sandbox)
+  {
+    if (!is_live(el)) {
+      return false;
+    }
+    sandbox = el.owner->sandbox.load(std::memory_order_acquire);
+    last = el.owner->last.load(std::memory_order_relaxed);
+    // The slot may have been reused while it was read
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return el.owner->id.load(std::memory_order_relaxed) == el.id;
+  }
+
+  // Called with write_lock held
+  inline slot* allocate_slot()
+  {
+    if (!free_slots.empty()) {
+      slot* ret = free_slots.back();
+      free_slots.pop_back();
+      return ret;
+    }
+
+    if (next_offset == get_chunk_size(next_chunk)) {
+      next_chunk++;
+      next_offset = 0;
+    }
+    detail::dynamic_check(next_chunk < max_chunks,
+                          "Too many sandboxes have been created");
+    if (chunks[next_chunk] == nullptr) {
+      chunks[next_chunk] = new slot[get_chunk_size(next_chunk)];
+    }
+    slot* ret = &chunks[next_chunk][next_offset];
+    next_offset++;
+    return ret;
+  }
+
+  // Called with write_lock held. Frees the retired snapshots that no lookup
+  // protects.
+  inline void retire(snapshot* prev)
+  {
+    retired.push_back(prev);
+    retired.erase(std::remove_if(retired.begin(),
+                                 retired.end(),
+                                 [&](snapshot* el) {
+                                   if (hazards.is_protected(el)) {
+                                     return false;
+                                   }
+                                   delete el;
+                                   return true;
+                                 }),
+                  retired.end());
+  }
+
+  // Called with write_lock held. Publishes a new snapshot whose base holds
+  // the live entries of the current one, and an empty pending list.
+  inline void merge()
+  {
+    snapshot* curr = current.load(std::memory_order_relaxed);
+    size_t count = curr->pending_count.load(std::memory_order_relaxed);
+    auto base = std::make_unique<sorted_ranges>();
+    std::vector<range> added;
+    for (size_t i = 0; i < count; i++) {
+      const range& el = curr->pending[i];
+      if (is_live(el)) {
+        (el.start != 0 ? added : base->unranged).push_back(el);
+      }
+    }
+    std::sort(added.begin(), added.end(), [](const range& a, const range& b) {
+      return a.start < b.start;
+    });
+    for (auto& el : curr->base->unranged) {
+      if (is_live(el)) {
+        base->unranged.push_back(el);
+      }
+    }
+    base->ranges.reserve(curr->base->ranges.size() + added.size());
+    auto pos = added.begin();
+    for (auto& el : curr->base->ranges) {
+      if (!is_live(el)) {
+        continue;
+      }
+      for (; pos != added.end() && pos->start < el.start; ++pos) {
+        base->ranges.push_back(*pos);
+      }
+      base->ranges.push_back(el);
+    }
+    base->ranges.insert(base->ranges.end(), pos, added.end());
+
+    // Merging copies the base, so a small base is merged after fewer appends.
+    // Merging at least every quarter of the base's size keeps appends
+    // amortized O(1) while lookups scan few pending entries.
+    size_t capacity = std::min(
+      merge_threshold,
+      std::max<size_t>(1, (base->ranges.size() + base->unranged.size()) / 4));
+    current.store(new snapshot(std::move(base), capacity));
+    removed_count = 0;
+    retire(curr);
+  }
+
+  // Called with write_lock held
+  inline void append_pending(const range& entry)
+  {
+    snapshot* curr = current.load(std::memory_order_relaxed);
+    size_t count = curr->pending_count.load(std::memory_order_relaxed);
+    curr->pending[count] = entry;
+    curr->pending_count.store(count + 1, std::memory_order_release);
+    if (count + 1 == curr->pending_capacity) {
+      merge();
+    }
+  }
+
+  // Called with the snapshot protected. Extends the entry's range if its
+  // sandbox's memory has grown to include val.
+  inline bool grow_range(const range& el, uintptr_t val, last_hit& hit)
+  {
+    T_Sandbox* sandbox = el.owner->sandbox.load();
+    if (sandbox == nullptr) {
+      return false;
+    }
+    // Removing a sandbox clears its slot's id before waiting for lookups that
+    // protect it, and the slot isn't reused until then
+    hazards.protect_unchecked(sandbox_hazard, sandbox);
+    uintptr_t start = 0;
+    uintptr_t last = 0;
+    // Memory that moved can't be fixed without resorting the index
+    bool ret = el.owner->id.load() == el.id &&
+               get_range(sandbox, start, last) && start == el.start &&
+               val <= last;
+    if (ret) {
+      uintptr_t curr = el.owner->last.load(std::memory_order_relaxed);
+      while (curr < last && !el.owner->last.compare_exchange_weak(
+                              curr, last, std::memory_order_relaxed)) {
+      }
+      hit.sandbox = sandbox;
+      hit.start = start;
+      hit.last = last;
+    }
+    hazards.clear(sandbox_hazard);
+    return ret;
+  }
+
+  // Called with the snapshot protected
+  inline bool check_unranged(const range& el, const void* p, last_hit& hit)
+  {
+    T_Sandbox* sandbox = el.owner->sandbox.load();
+    if (sandbox == nullptr) {
+      return false;
+    }
+    hazards.protect_unchecked(sandbox_hazard, sandbox);
+    bool ret = el.owner->id.load() == el.id &&
+               sandbox->is_pointer_in_sandbox_memory(p);
+    hazards.clear(sandbox_hazard);
+    if (ret) {
+      hit.sandbox = sandbox;
+    }
+    return ret;
+  }
+
+  // Called with the snapshot protected
+  inline bool find_entry(const snapshot& curr, const void* p, last_hit& hit)
+  {
+    auto val = reinterpret_cast<uintptr_t>(p);
+    const sorted_ranges& base = *curr.base;
+
+    // Live ranges don't overlap, so only the live range that starts closest
+    // below the pointer can hold it
+    const range* closest = nullptr;
+    uintptr_t closest_last = 0;
+    T_Sandbox* closest_sandbox = nullptr;
+    auto pos =
+      std::upper_bound(base.ranges.begin(), base.ranges.end(), val, compare_start);
+    while (pos != base.ranges.begin()) {
+      --pos;
+      if (read_entry(*pos, closest_last, closest_sandbox)) {
+        closest = &*pos;
+        break;
+      }
+    }
+
+    size_t count = curr.pending_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+      const range& el = curr.pending[i];
+      uintptr_t last = 0;
+      T_Sandbox* sandbox = nullptr;
+      if (el.start == 0 || el.start > val ||
+          (closest != nullptr && el.start < closest->start) ||
+          !read_entry(el, last, sandbox)) {
+        continue;
+      }
+      closest = &el;
+      closest_last = last;
+      closest_sandbox = sandbox;
+    }
+
+    if (closest != nullptr) {
+      if (val <= closest_last) {
+        hit.sandbox = closest_sandbox;
+        hit.start = closest->start;
+        hit.last = closest_last;
+        return true;
+      }
+      if (grow_range(*closest, val, hit)) {
+        return true;
+      }
+    }
+
+    for (auto& el : base.unranged) {
+      if (check_unranged(el, p, hit)) {
+        return true;
+      }
+    }
+    for (size_t i = 0; i < count; i++) {
+      const range& el = curr.pending[i];
+      if (el.start == 0 && check_unranged(el, p, hit)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+public:
+  /**
+   * @brief Identifies the registration of a sandbox, so it can be removed
+   * without a search.
+   */
+  using registration = slot*;
+
+  sandbox_index() = default;
+  sandbox_index(const sandbox_index&) = delete;
+  sandbox_index& operator=(const sandbox_index&) = delete;
+
+  ~sandbox_index()
+  {
+    delete current.load();
+    for (auto el : retired) {
+      delete el;
+    }
+    for (auto chunk : chunks) {
+      delete[] chunk;
+    }
+  }
+
+  inline registration add(T_Sandbox* sandbox)
+  {
+    uintptr_t start = 0;
+    uintptr_t last = 0;
+    bool has_range = get_range(sandbox, start, last);
+
+    RLBOX_ACQUIRE_UNIQUE_GUARD(lock, write_lock);
+    slot* ret = allocate_slot();
+    const uint64_t id = next_id++;
+    ret->start.store(has_range ? start : 0, std::memory_order_relaxed);
+    ret->last.store(has_range ? last : 0, std::memory_order_relaxed);
+    ret->sandbox.store(sandbox, std::memory_order_relaxed);
+    // Publishes the fields above to lookups that read the slot through an
+    // entry with this id
+    ret->id.store(id, std::memory_order_release);
+    if (has_range) {
+      ranged_count++;
+    }
+
+    if (current.load(std::memory_order_relaxed) == nullptr) {
+      current.store(
+        new snapshot(std::make_unique<sorted_ranges>(), merge_threshold));
+    }
+    append_pending(range{ has_range ? start : 0, ret, id });
+    return ret;
+  }
+
+  inline void remove(registration reg)
+  {
+    detail::dynamic_check(
+      reg != nullptr,
+      "Unexpected state. Destroying a sandbox that was never initialized.");
+
+    T_Sandbox* sandbox = nullptr;
+    {
+      RLBOX_ACQUIRE_UNIQUE_GUARD(lock, write_lock);
+      // The index entries of the registration are now stale. They are
+      // dropped by the next merge, so that lookups don't skip over many of
+      // them.
+      reg->id.store(0);
+      sandbox = reg->sandbox.exchange(nullptr);
+      if (reg->start.load(std::memory_order_relaxed) != 0) {
+        ranged_count--;
+      }
+      removed_count++;
+      if (removed_count == merge_threshold) {
+        merge();
+      }
+    }
+
+    // Bumped only after the sandbox is unreachable from the slots and the
+    // index, so a lookup that sees the new generation can't find it
+    generation++;
+    // Only waits if a lookup is calling into the sandbox right now. The slot
+    // can be reused once no lookup can be extending its range.
+    hazards.wait_until_unprotected(sandbox);
+
+    RLBOX_ACQUIRE_UNIQUE_GUARD(lock, write_lock);
+    free_slots.push_back(reg);
+  }
+
+  /**
+   * @brief Whether any live sandbox reports a memory range.
+   */
+  inline bool has_ranges() const { return ranged_count.load() != 0; }
+
+  /**
+   * @brief Find the sandbox whose memory contains the given pointer.
+   *
+   * @return The sandbox or nullptr if no sandbox contains the pointer.
+   */
+  inline T_Sandbox* find(const void* p)
+  {
+    // Read before the slots, so that a sandbox removed during the lookup is
+    // cached with a stale generation
+    const uint64_t curr_generation = generation.load();
+    auto val = reinterpret_cast<uintptr_t>(p);
+    if (cached.index_id == index_id && cached.generation == curr_generation) {
+      if (cached.start != 0) {
+        if (val >= cached.start && val <= cached.last) {
+          return cached.sandbox;
+        }
+      } else {
+        // Removing the sandbox bumps the generation before waiting for
+        // lookups that protect it, so it is safe to use if the generation
+        // hasn't changed once it is protected
+        hazards.protect_unchecked(sandbox_hazard, cached.sandbox);
+        bool hit = generation.load() == curr_generation &&
+                   cached.sandbox->is_pointer_in_sandbox_memory(p);
+        hazards.clear(sandbox_hazard);
+        if (hit) {
+          return cached.sandbox;
+        }
+      }
+    }
+
+    snapshot* curr = hazards.protect(snapshot_hazard, current);
+    T_Sandbox* ret = nullptr;
+    if (curr != nullptr) {
+      // The slot's range belongs to the sandbox until the sandbox is
+      // removed, after which the generation no longer matches
+      last_hit hit{ index_id, curr_generation, nullptr, 0, 0 };
+      if (find_entry(*curr, p, hit)) {
+        cached = hit;
+        ret = hit.sandbox;
+      }
+    }
+    hazards.clear(snapshot_hazard);
+    return ret;
+  }
+};
+
+}
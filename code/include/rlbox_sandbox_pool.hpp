@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+
+#include "rlbox.hpp"
+#include "rlbox_helpers.hpp"
+
+namespace rlbox {
+
+/**
+ * @brief A pool of sandboxes that are created ahead of time, so that creating
+ * and destroying sandboxes is kept off the request path.
+ *
+ * Free sandboxes are sharded by core, and each shard has its own lock. A
+ * checkout takes a sandbox from the shard of the current core, and only looks
+ * at other shards when that shard is empty. If every shard is empty, a new
+ * sandbox is created. Sandboxes are returned to the shard they were checked
+ * out from.
+ *
+ * @tparam T_Sbx Type of sandbox. For the null sandbox this is
+ * `rlbox_noop_sandbox`
+ */
+template<typename T_Sbx>
+class rlbox_sandbox_pool
+{
+public:
+  using T_Sandbox = rlbox_sandbox<T_Sbx>;
+  // Called to create each sandbox. This should call create_sandbox and return
+  // its result. Sandboxes that fail to create are not added to the pool.
+  using T_CreateHook = std::function<bool(T_Sandbox&)>;
+  // Called when a sandbox is returned to the pool. If this returns false, the
+  // sandbox is destroyed and replaced with a new one.
+  using T_ResetHook = std::function<bool(T_Sandbox&)>;
+
+  /**
+   * @brief RAII handle to a sandbox checked out from the pool. The sandbox is
+   * returned to the pool when the handle is destroyed. Handles must not
+   * outlive the pool.
+   */
+  class handle
+  {
+    friend class rlbox_sandbox_pool;
+
+  private:
+    rlbox_sandbox_pool* pool = nullptr;
+    T_Sandbox* sandbox = nullptr;
+    size_t shard = 0;
+
+    handle(rlbox_sandbox_pool* p_pool, T_Sandbox* p_sandbox, size_t p_shard)
+      : pool(p_pool)
+      , sandbox(p_sandbox)
+      , shard(p_shard)
+    {}
+
+  public:
+    handle() = default;
+    handle(const handle&) = delete;
+    handle& operator=(const handle&) = delete;
+
+    handle(handle&& other) noexcept
+      : pool(std::exchange(other.pool, nullptr))
+      , sandbox(std::exchange(other.sandbox, nullptr))
+      , shard(other.shard)
+    {}
+
+    handle& operator=(handle&& other) noexcept
+    {
+      if (this != &other) {
+        release();
+        pool = std::exchange(other.pool, nullptr);
+        sandbox = std::exchange(other.sandbox, nullptr);
+        shard = other.shard;
+      }
+      return *this;
+    }
+
+    ~handle() { release(); }
+
+    /**
+     * @brief Return the sandbox to the pool early.
+     */
+    inline void release()
+    {
+      if (sandbox != nullptr) {
+        pool->return_sandbox(sandbox, shard);
+        pool = nullptr;
+        sandbox = nullptr;
+      }
+    }
+
+    inline T_Sandbox* get() const noexcept { return sandbox; }
+    inline T_Sandbox& operator*() const noexcept { return *sandbox; }
+    inline T_Sandbox* operator->() const noexcept { return sandbox; }
+    inline explicit operator bool() const noexcept
+    {
+      return sandbox != nullptr;
+    }
+  };
+
+private:
+  // Keep shards on separate cache lines so that cores don't contend
+  struct alignas(64) shard_t
+  {
+    std::mutex lock;
+    std::vector<T_Sandbox*> free_sandboxes;
+  };
+
+  T_CreateHook create_hook;
+  T_ResetHook reset_hook;
+  std::unique_ptr<shard_t[]> shards;
+  size_t shard_count;
+
+  std::mutex all_sandboxes_lock;
+  std::vector<std::unique_ptr<T_Sandbox>> all_sandboxes;
+
+  inline size_t get_current_shard() const
+  {
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+      return static_cast<size_t>(cpu) % shard_count;
+    }
+#endif
+    // Fall back to spreading threads across shards
+    static std::atomic<size_t> next_thread_index{ 0 };
+    thread_local size_t thread_index = next_thread_index++;
+    return thread_index % shard_count;
+  }
+
+  // Returns nullptr if the sandbox could not be created
+  inline T_Sandbox* make_sandbox()
+  {
+    auto sandbox = std::make_unique<T_Sandbox>();
+    if (!create_hook(*sandbox)) {
+      return nullptr;
+    }
+    auto ret = sandbox.get();
+    std::lock_guard<std::mutex> lock(all_sandboxes_lock);
+    all_sandboxes.emplace_back(std::move(sandbox));
+    return ret;
+  }
+
+  // Returns false, and removes the sandbox from the pool, if it could not be
+  // created again
+  inline bool replace_sandbox(T_Sandbox* sandbox)
+  {
+    sandbox->destroy_sandbox();
+    if (create_hook(*sandbox)) {
+      return true;
+    }
+
+    std::lock_guard<std::mutex> lock(all_sandboxes_lock);
+    auto it = std::find_if(all_sandboxes.begin(),
+                           all_sandboxes.end(),
+                           [&](auto& curr) { return curr.get() == sandbox; });
+    RLBOX_DEBUG_ASSERT(it != all_sandboxes.end());
+    all_sandboxes.erase(it);
+    return false;
+  }
+
+  inline T_Sandbox* try_pop(size_t shard)
+  {
+    auto& curr = shards[shard];
+    std::lock_guard<std::mutex> lock(curr.lock);
+    if (curr.free_sandboxes.empty()) {
+      return nullptr;
+    }
+    auto ret = curr.free_sandboxes.back();
+    curr.free_sandboxes.pop_back();
+    return ret;
+  }
+
+  inline void return_sandbox(T_Sandbox* sandbox, size_t shard)
+  {
+    if (reset_hook && !reset_hook(*sandbox) && !replace_sandbox(sandbox)) {
+      return;
+    }
+    {
+      auto& curr = shards[shard];
+      std::lock_guard<std::mutex> lock(curr.lock);
+      curr.free_sandboxes.push_back(sandbox);
+    }
+  }
+
+public:
+  /**
+   * @brief Create a pool and its sandboxes.
+   *
+   * @param count The number of sandboxes to create up front. Fewer are added
+   * if some fail to create.
+   * @param p_create_hook Called to create each sandbox. This should call
+   * create_sandbox with the arguments for the sandbox plugin and return its
+   * result.
+   * @param p_reset_hook Optional. Called when a sandbox is returned to the
+   * pool, to clear any state left over from its last use.
+   * @param p_shard_count The number of shards. Defaults to the number of
+   * cores.
+   */
+  rlbox_sandbox_pool(size_t count,
+                     T_CreateHook p_create_hook,
+                     T_ResetHook p_reset_hook = nullptr,
+                     size_t p_shard_count = 0)
+    : create_hook(std::move(p_create_hook))
+    , reset_hook(std::move(p_reset_hook))
+  {
+    detail::dynamic_check(create_hook != nullptr,
+                          "rlbox_sandbox_pool requires a create hook");
+    shard_count = p_shard_count;
+    if (shard_count == 0) {
+      shard_count = std::thread::hardware_concurrency();
+    }
+    if (shard_count == 0) {
+      shard_count = 1;
+    }
+    shards = std::make_unique<shard_t[]>(shard_count);
+
+    size_t next_shard = 0;
+    for (size_t i = 0; i < count; i++) {
+      auto sandbox = make_sandbox();
+      if (sandbox != nullptr) {
+        shards[next_shard].free_sandboxes.push_back(sandbox);
+        next_shard = (next_shard + 1) % shard_count;
+      }
+    }
+  }
+
+  rlbox_sandbox_pool(const rlbox_sandbox_pool&) = delete;
+  rlbox_sandbox_pool& operator=(const rlbox_sandbox_pool&) = delete;
+
+  ~rlbox_sandbox_pool()
+  {
+#ifdef RLBOX_ENABLE_DEBUG_ASSERTIONS
+    size_t free_count = 0;
+    for (size_t i = 0; i < shard_count; i++) {
+      free_count += shards[i].free_sandboxes.size();
+    }
+    // Sandboxes should not be checked out when the pool is destroyed
+    RLBOX_DEBUG_ASSERT(free_count == all_sandboxes.size());
+#endif
+    for (auto& sandbox : all_sandboxes) {
+      sandbox->destroy_sandbox();
+    }
+  }
+
+  /**
+   * @brief Check out a sandbox. The sandbox is returned to the pool when the
+   * handle is destroyed.
+   *
+   * @return A handle to the sandbox. If the pool is exhausted and a new
+   * sandbox fails to create, the handle is empty.
+   */
+  inline handle checkout()
+  {
+    const size_t home = get_current_shard();
+    for (size_t i = 0; i < shard_count; i++) {
+      auto shard = (home + i) % shard_count;
+      auto sandbox = try_pop(shard);
+      if (sandbox != nullptr) {
+        return handle(this, sandbox, shard);
+      }
+    }
+
+    // The pool is exhausted, so grow it
+    auto sandbox = make_sandbox();
+    if (sandbox == nullptr) {
+      return handle();
+    }
+    return handle(this, sandbox, home);
+  }
+
+  /**
+   * @brief The total number of sandboxes owned by the pool.
+   */
+  inline size_t size()
+  {
+    std::lock_guard<std::mutex> lock(all_sandboxes_lock);
+    return all_sandboxes.size();
+  }
+
+  /**
+   * @brief The number of shards that free sandboxes are spread over.
+   */
+  inline size_t get_shard_count() const noexcept { return shard_count; }
+};
+
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "rlbox.hpp"
+#include "rlbox_helpers.hpp"
+
+namespace rlbox {
+
+/**
+ * @brief An allocator for small objects in sandbox memory. Memory is taken
+ * from the sandbox in large chunks with malloc_in_sandbox, so each chunk's
+ * range is validated once, and small objects are handed out from the chunks
+ * in O(1) without calling into the sandbox plugin.
+ *
+ * Objects are rounded up to power of two size classes, and each chunk holds
+ * objects of a single size class. Freed objects are kept in a free list per
+ * size class and reused by later allocations of the same class. Objects too
+ * large for a size class are passed through to malloc_in_sandbox and
+ * free_in_sandbox. The free lists are kept in app memory, as the sandbox can
+ * write to any memory it owns, including freed objects. A freed pointer must
+ * be the start of an allocated object of the freed size class, which is
+ * checked against the chunk it is in.
+ *
+ * Chunks are returned to the sandbox when the allocator is destroyed, which
+ * must happen before the sandbox is destroyed. This class is not thread-safe.
+ *
+ * @tparam T_Sbx Type of sandbox. For the null sandbox this is
+ * `rlbox_noop_sandbox`
+ */
+template<typename T_Sbx>
+class sandbox_slab_allocator
+{
+  static constexpr size_t min_block_size = 8;
+  static constexpr size_t num_size_classes = 7;
+  static constexpr size_t max_block_size = min_block_size
+                                           << (num_size_classes - 1);
+  // Blocks are aligned to their size, up to this alignment
+  static constexpr size_t max_block_align = 16;
+  static constexpr uint32_t no_chunk = std::numeric_limits<uint32_t>::max();
+
+  struct chunk
+  {
+    tainted<char*, T_Sbx> memory;
+    // The first block, aligned for the chunk's size class
+    char* blocks;
+    size_t size_class;
+    uint32_t block_count;
+    // Blocks below this have been handed out at least once
+    uint32_t used_count;
+    // Whether each block is in the free list
+    std::vector<bool> is_free;
+  };
+
+  struct block_ref
+  {
+    uint32_t chunk;
+    uint32_t index;
+  };
+
+  rlbox_sandbox<T_Sbx>& sandbox;
+  uint32_t chunk_size;
+  std::vector<chunk> chunks;
+  // Indexes of chunks sorted by address, to find the chunk of a freed block
+  std::vector<uint32_t> chunks_by_address;
+  // The chunk each size class hands out unused blocks from
+  uint32_t current_chunks[num_size_classes];
+  std::vector<block_ref> free_lists[num_size_classes];
+
+  template<typename T>
+  static inline bool is_small(uint32_t count)
+  {
+    if constexpr (sizeof(T) > max_block_size || alignof(T) > max_block_align) {
+      return false;
+    } else {
+      return count != 0 && count <= max_block_size / sizeof(T);
+    }
+  }
+
+  static inline size_t get_size_class(size_t size)
+  {
+    size_t size_class = 0;
+    while ((min_block_size << size_class) < size) {
+      size_class++;
+    }
+    return size_class;
+  }
+
+  // Returns no_chunk if the sandbox is out of memory
+  inline uint32_t add_chunk(size_t size_class)
+  {
+    auto memory = sandbox.template malloc_in_sandbox<char>(chunk_size);
+    if (memory == nullptr) {
+      return no_chunk;
+    }
+
+    // The whole chunk was bounds checked by malloc_in_sandbox
+    char* start = memory.UNSAFE_unverified();
+    const size_t block_size = min_block_size << size_class;
+    const size_t align =
+      block_size < max_block_align ? block_size : max_block_align;
+    auto val = reinterpret_cast<uintptr_t>(start);
+    auto offset = static_cast<size_t>(
+      ((val + align - 1) & ~static_cast<uintptr_t>(align - 1)) - val);
+    auto block_count = static_cast<uint32_t>((chunk_size - offset) / block_size);
+
+    auto index = static_cast<uint32_t>(chunks.size());
+    chunks.push_back(chunk{ memory,
+                            start + offset,
+                            size_class,
+                            block_count,
+                            0,
+                            std::vector<bool>(block_count, false) });
+    auto pos = std::upper_bound(
+      chunks_by_address.begin(),
+      chunks_by_address.end(),
+      start,
+      [&](char* p, uint32_t i) { return p < chunks[i].blocks; });
+    chunks_by_address.insert(pos, index);
+    return index;
+  }
+
+  // Returns null if the sandbox is out of memory
+  inline char* allocate_block(size_t size_class)
+  {
+    const size_t block_size = min_block_size << size_class;
+    auto& free_list = free_lists[size_class];
+    if (!free_list.empty()) {
+      block_ref ret = free_list.back();
+      free_list.pop_back();
+      auto& curr = chunks[ret.chunk];
+      curr.is_free[ret.index] = false;
+      return curr.blocks + ret.index * block_size;
+    }
+
+    uint32_t& current = current_chunks[size_class];
+    if (current == no_chunk ||
+        chunks[current].used_count == chunks[current].block_count) {
+      current = add_chunk(size_class);
+      if (current == no_chunk) {
+        return nullptr;
+      }
+    }
+
+    auto& curr = chunks[current];
+    char* ret = curr.blocks + curr.used_count * block_size;
+    curr.used_count++;
+    return ret;
+  }
+
+public:
+  static constexpr uint32_t default_chunk_size = 64 * 1024;
+
+  /**
+   * @brief Construct an allocator for the given sandbox. No memory is taken
+   * from the sandbox until the first allocation.
+   *
+   * @param chunk_size The size of the chunks taken from the sandbox. This
+   * must have room for an object of the largest size class.
+   */
+  explicit sandbox_slab_allocator(rlbox_sandbox<T_Sbx>& p_sandbox,
+                                  uint32_t p_chunk_size = default_chunk_size)
+    : sandbox(p_sandbox)
+    , chunk_size(p_chunk_size)
+  {
+    detail::dynamic_check(chunk_size >= max_block_size + max_block_align,
+                          "sandbox_slab_allocator chunk size is too small");
+    for (auto& current : current_chunks) {
+      current = no_chunk;
+    }
+  }
+
+  sandbox_slab_allocator(const sandbox_slab_allocator&) = delete;
+  sandbox_slab_allocator& operator=(const sandbox_slab_allocator&) = delete;
+
+  ~sandbox_slab_allocator()
+  {
+    for (auto& curr : chunks) {
+      sandbox.free_in_sandbox(curr.memory);
+    }
+  }
+
+  /**
+   * @brief Allocate an array in sandbox memory, like
+   * rlbox_sandbox::malloc_in_sandbox.
+   *
+   * @tparam T The type of the array elements.
+   * @param count The number of array elements to allocate.
+   * @return The allocation, or null if the sandbox is out of memory.
+   */
+  template<typename T>
+  inline tainted<T*, T_Sbx> malloc_in_sandbox(uint32_t count = 1)
+  {
+    if (!is_small<T>(count)) {
+      return sandbox.template malloc_in_sandbox<T>(count);
+    }
+
+    char* block = allocate_block(get_size_class(count * sizeof(T)));
+    return tainted<T*, T_Sbx>::internal_factory(reinterpret_cast<T*>(block));
+  }
+
+  /**
+   * @brief Free an allocation made by malloc_in_sandbox.
+   *
+   * @param ptr The allocation to free.
+   * @param count The number of array elements, which must be the same as
+   * passed to malloc_in_sandbox.
+   */
+  template<typename T>
+  inline void free_in_sandbox(tainted<T*, T_Sbx> ptr, uint32_t count = 1)
+  {
+    if (!is_small<T>(count)) {
+      sandbox.free_in_sandbox(ptr);
+      return;
+    }
+
+    auto block = reinterpret_cast<char*>(
+      const_cast<std::remove_const_t<T>*>(ptr.UNSAFE_unverified()));
+    if (block == nullptr) {
+      return;
+    }
+    // Make sure the block was handed out for this size class, so that a
+    // mismatched count or a foreign pointer can't put memory of the wrong
+    // size, or memory outside the chunks, in a free list
+    const size_t size_class = get_size_class(count * sizeof(T));
+    const size_t block_size = min_block_size << size_class;
+    auto pos = std::upper_bound(
+      chunks_by_address.begin(),
+      chunks_by_address.end(),
+      block,
+      [&](char* p, uint32_t i) { return p < chunks[i].blocks; });
+    detail::dynamic_check(pos != chunks_by_address.begin(),
+                          "Freed a block not allocated by this allocator");
+    const uint32_t chunk_index = *(pos - 1);
+    auto& curr = chunks[chunk_index];
+    auto offset = static_cast<size_t>(block - curr.blocks);
+    detail::dynamic_check(
+      curr.size_class == size_class && offset % block_size == 0 &&
+        offset / block_size < curr.used_count,
+      "Freed a block not allocated by this allocator with this size");
+    auto index = static_cast<uint32_t>(offset / block_size);
+    detail::dynamic_check(!curr.is_free[index], "Freed a block twice");
+    curr.is_free[index] = true;
+    free_lists[size_class].push_back(block_ref{ chunk_index, index });
+  }
+};
+
+}
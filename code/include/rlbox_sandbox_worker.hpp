@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "rlbox.hpp"
+#include "rlbox_stdlib_polyfill.hpp"
+
+namespace rlbox::detail {
+
+/**
+ * @brief A thread that runs queued tasks in order. This is used to run
+ * asynchronous sandbox invocations. Destroying the worker finishes all queued
+ * tasks before joining the thread.
+ *
+ * A task can't destroy its own worker, as the thread would join itself.
+ * Instead it calls abandon, which drops the tasks still queued and lets the
+ * thread free the worker once the current task returns.
+ */
+class sandbox_worker : public sandbox_worker_base
+{
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::packaged_task<void()>> tasks;
+  bool stopping = false;
+  bool abandoned = false;
+  // Declared last so that the state above is initialized before the thread
+  // starts
+  std::thread thread;
+
+  inline void run()
+  {
+    while (true) {
+      std::packaged_task<void()> task;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        cv.wait(guard, [&] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) {
+          if (abandoned) {
+            // Nothing else refers to the worker once it is abandoned
+            guard.unlock();
+            delete this;
+          }
+          return;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+public:
+  sandbox_worker()
+    : thread([this] { run(); })
+  {}
+
+  sandbox_worker(const sandbox_worker&) = delete;
+  sandbox_worker& operator=(const sandbox_worker&) = delete;
+
+  ~sandbox_worker() override
+  {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    cv.notify_one();
+    // An abandoned worker is freed by its own, detached, thread
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  inline bool is_worker_thread() const override
+  {
+    return std::this_thread::get_id() == thread.get_id();
+  }
+
+  inline void abandon() override
+  {
+    RLBOX_DEBUG_ASSERT(is_worker_thread());
+    std::deque<std::packaged_task<void()>> dropped;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      // The futures of the dropped tasks report std::future_errc::broken_promise
+      dropped.swap(tasks);
+      stopping = true;
+      abandoned = true;
+      thread.detach();
+    }
+  }
+
+  /**
+   * @brief Queue a task to run on the worker thread.
+   *
+   * @param func The task to run.
+   * @return A std::future for the result of the task. Exceptions thrown by the
+   * task are rethrown by the future.
+   */
+  template<typename T_Func>
+  inline auto submit(T_Func&& func)
+  {
+    using T_Result = polyfill::invoke_result_t<T_Func>;
+    std::packaged_task<T_Result()> task(std::forward<T_Func>(func));
+    auto ret = task.get_future();
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      tasks.emplace_back([task = std::move(task)]() mutable { task(); });
+    }
+    cv.notify_one();
+    return ret;
+  }
+};
+
+/**
+ * @brief Queues rlbox_sandbox's asynchronous invocations on the sandbox's
+ * worker, starting the worker on first use.
+ */
+template<typename T_Sbx>
+struct sandbox_async_invoker
+{
+  template<typename T_Func>
+  static inline auto submit(std::atomic<sandbox_worker_base*>& worker_slot,
+                            T_Func&& func)
+  {
+    sandbox_worker_base* worker = worker_slot.load(std::memory_order_acquire);
+    if (!worker) {
+      auto created = std::make_unique<sandbox_worker>();
+      // If another thread started a worker first, use that one instead
+      if (worker_slot.compare_exchange_strong(worker,
+                                              created.get(),
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire)) {
+        worker = created.release();
+      }
+    }
+    return static_cast<sandbox_worker*>(worker)->submit(
+      std::forward<T_Func>(func));
+  }
+};
+
+}
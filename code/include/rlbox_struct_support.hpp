@@ -2,6 +2,7 @@
 // IWYU pragma: private, include "rlbox.hpp"
 // IWYU pragma: friend "rlbox_.*\.hpp"
 
+#include <cstddef>
 #include <cstring>
 #include <functional>
 #include <type_traits>
@@ -33,6 +34,31 @@ using convert_to_sandbox_equivalent_t =
 // This is used by rlbox_load_structs_from_library to test the current namespace
 struct markerStruct
 {};
+
+// Whether a struct is laid out identically in the sandbox, so that converting
+// it is a plain copy. Specialized for each struct by
+// rlbox_load_structs_from_library.
+template<typename T, typename T_Sbx>
+struct struct_layout_matches : std::false_type
+{};
+
+// Whether a struct field is represented identically in the sandbox. Function
+// pointers are excluded, as with invoke parameters, because plugins may
+// swizzle them through function tables that a plain copy would bypass.
+template<typename T, typename T_Sbx>
+constexpr bool field_layout_matches()
+{
+  using T_NoCV = std::remove_cv_t<T>;
+  if constexpr (std::is_array_v<T_NoCV>) {
+    return field_layout_matches<std::remove_extent_t<T_NoCV>, T_Sbx>();
+  } else if constexpr (std::is_class_v<T_NoCV>) {
+    return struct_layout_matches<T_NoCV, T_Sbx>::value;
+  } else {
+    return is_abi_identical_v<T_Sbx> &&
+           (std::is_arithmetic_v<T_NoCV> || std::is_enum_v<T_NoCV> ||
+            (std::is_pointer_v<T_NoCV> && !is_func_ptr_v<T_NoCV>));
+  }
+}
 }
 
 #define helper_create_converted_field(fieldType, fieldName, isFrozen)          \
@@ -40,6 +66,10 @@ struct markerStruct
 
 #define helper_no_op()
 
+#define helper_check_field_layout(fieldType, fieldName, isFrozen)              \
+  &&::rlbox::detail::field_layout_matches<fieldType, T_Sbx>() &&               \
+    offsetof(T_App, fieldName) == offsetof(T_Converted, fieldName)
+
 #define sandbox_equivalent_specialization(T, libId)                            \
   template<typename T_Sbx>                                                     \
   struct Sbx_##libId##_##T                                                     \
@@ -58,6 +88,20 @@ struct markerStruct
       std::enable_if_t<std::is_same_v<T_Template, T>>>                         \
     {                                                                          \
       using type = Sbx_##libId##_##T<T_Sbx>;                                   \
+    };                                                                         \
+                                                                               \
+    template<typename T_Sbx>                                                   \
+    struct struct_layout_matches<T, T_Sbx>                                     \
+    {                                                                          \
+      using T_App = T;                                                         \
+      using T_Converted = Sbx_##libId##_##T<T_Sbx>;                            \
+      static constexpr bool value =                                            \
+        std::is_trivially_copyable_v<T_App> &&                                 \
+        std::is_trivially_copyable_v<T_Converted> &&                           \
+        sizeof(T_App) == sizeof(T_Converted)                                   \
+          sandbox_fields_reflection_##libId##_class_##T(                       \
+            helper_check_field_layout,                                         \
+            helper_no_op);                                                     \
     };                                                                         \
   }
 
@@ -73,6 +117,18 @@ struct markerStruct
   ::rlbox::detail::convert_type<T_Sbx, Direction, Context>(                    \
     lhs.fieldName, rhs.fieldName, example_unsandboxed_ptr, sandbox_ptr);
 
+// Converts rhs to lhs, which are T and its sandbox equivalent in either order.
+// Structs laid out identically in the sandbox are copied whole instead of
+// field by field.
+#define helper_convert_struct(T, libId)                                        \
+  if constexpr (::rlbox::detail::struct_layout_matches<T, T_Sbx>::value) {     \
+    static_assert(sizeof(lhs) == sizeof(rhs));                                 \
+    std::memcpy(&lhs, &rhs, sizeof(lhs));                                      \
+  } else {                                                                     \
+    sandbox_fields_reflection_##libId##_class_##T(helper_convert_type,         \
+                                                  helper_no_op)                \
+  }
+
 #define helper_find_example_pointer_or_null(fieldType, fieldName, isFrozen)    \
   {                                                                            \
     const void* ret = fieldName.find_example_pointer_or_null();                \
@@ -113,8 +169,7 @@ struct markerStruct
        * as example_unsandboxed_ptr */                                         \
       const void* example_unsandboxed_ptr = &rhs;                              \
       rlbox_sandbox<T_Sbx>* sandbox_ptr = nullptr;                             \
-      sandbox_fields_reflection_##libId##_class_##T(helper_convert_type,       \
-                                                    helper_no_op)              \
+      helper_convert_struct(T, libId)                                          \
                                                                                \
         return lhs;                                                            \
     }                                                                          \
@@ -208,8 +263,7 @@ struct markerStruct
       constexpr auto Context = detail::adjust_type_context::SANDBOX;           \
       const void* example_unsandboxed_ptr = nullptr;                           \
       rlbox_sandbox<T_Sbx>* sandbox_ptr = &sandbox;                            \
-      sandbox_fields_reflection_##libId##_class_##T(helper_convert_type,       \
-                                                    helper_no_op)              \
+      helper_convert_struct(T, libId)                                          \
                                                                                \
         return lhs;                                                            \
     }                                                                          \
@@ -241,8 +295,7 @@ struct markerStruct
       /* example_unsandboxed_ptr */                                            \
       const void* example_unsandboxed_ptr = &rhs;                              \
       rlbox_sandbox<T_Sbx>* sandbox_ptr = nullptr;                             \
-      sandbox_fields_reflection_##libId##_class_##T(helper_convert_type,       \
-                                                    helper_no_op)              \
+      helper_convert_struct(T, libId)                                          \
     }                                                                          \
                                                                                \
     inline tainted_opaque<MaybeConst T, T_Sbx> to_opaque()                     \
@@ -287,8 +340,7 @@ struct markerStruct
     /*  use as example_unsandboxed_ptr */                                      \
     const void* example_unsandboxed_ptr = &lhs;                                \
     rlbox_sandbox<T_Sbx>* sandbox_ptr = nullptr;                               \
-    sandbox_fields_reflection_##libId##_class_##T(helper_convert_type,         \
-                                                  helper_no_op)                \
+    helper_convert_struct(T, libId)                                            \
                                                                                \
       return *this;                                                            \
   }
@@ -311,8 +363,7 @@ struct markerStruct
                              const void* example_unsandboxed_ptr,              \
                              rlbox_sandbox<T_Sbx>* sandbox_ptr)                \
       {                                                                        \
-        sandbox_fields_reflection_##libId##_class_##T(helper_convert_type,     \
-                                                      helper_no_op)            \
+        helper_convert_struct(T, libId)                                        \
       }                                                                        \
     };                                                                         \
                                                                                \
@@ -332,8 +383,7 @@ struct markerStruct
                              const void* example_unsandboxed_ptr,              \
                              rlbox_sandbox<T_Sbx>* sandbox_ptr)                \
       {                                                                        \
-        sandbox_fields_reflection_##libId##_class_##T(helper_convert_type,     \
-                                                      helper_no_op)            \
+        helper_convert_struct(T, libId)                                        \
       }                                                                        \
     };                                                                         \
   }
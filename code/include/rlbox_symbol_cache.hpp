@@ -0,0 +1,197 @@
+#pragma once
+// IWYU pragma: private, include "rlbox.hpp"
+// IWYU pragma: friend "rlbox_.*\.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#ifndef RLBOX_USE_CUSTOM_SHARED_LOCK
+#  include <shared_mutex>
+#endif
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "rlbox_helpers.hpp"
+
+namespace rlbox::detail {
+
+/**
+ * @brief A read-mostly cache from symbol names to function pointers.
+ *
+ * Lookups are lock-free and do not allocate. They hash the name and probe an
+ * open addressed table. Inserts are serialized by a lock. When the table
+ * fills up, it is copied into a larger table and the new table is published
+ * with a single atomic store. Older tables are kept alive until the cache is
+ * destroyed, so concurrent readers never see freed memory. Entries are only
+ * removed by clear, so the total memory used is bounded by twice the final
+ * table size.
+ */
+class symbol_cache
+{
+  struct entry
+  {
+    // Published last. A non-null name means the other fields are valid.
+    std::atomic<const char*> name{ nullptr };
+    size_t name_len = 0;
+    size_t hash = 0;
+    void* value = nullptr;
+  };
+
+  struct table
+  {
+    size_t mask;
+    std::unique_ptr<entry[]> entries;
+
+    explicit table(size_t capacity)
+      : mask(capacity - 1)
+      , entries(new entry[capacity])
+    {}
+  };
+
+  static constexpr size_t initial_capacity = 16;
+
+  std::atomic<table*> current{ nullptr };
+
+  // Everything below is only accessed while holding write_lock
+  RLBOX_SHARED_LOCK(write_lock);
+  std::vector<std::unique_ptr<table>> tables;
+  std::vector<std::unique_ptr<char[]>> names;
+  size_t count = 0;
+
+  static inline size_t get_hash(std::string_view name)
+  {
+    // FNV-1a
+    uint64_t ret = 0xcbf29ce484222325ull;
+    for (char c : name) {
+      ret ^= static_cast<unsigned char>(c);
+      ret *= 0x100000001b3ull;
+    }
+    return static_cast<size_t>(ret ^ (ret >> 32));
+  }
+
+  static inline const entry* find_in(const table* t,
+                                     std::string_view name,
+                                     size_t hash)
+  {
+    for (size_t i = hash & t->mask;; i = (i + 1) & t->mask) {
+      const entry& curr = t->entries[i];
+      const char* curr_name = curr.name.load(std::memory_order_acquire);
+      if (curr_name == nullptr) {
+        return nullptr;
+      }
+      if (curr.hash == hash && curr.name_len == name.size() &&
+          std::memcmp(curr_name, name.data(), name.size()) == 0) {
+        return &curr;
+      }
+    }
+  }
+
+  static inline void insert_into(table* t,
+                                 const char* name,
+                                 size_t name_len,
+                                 size_t hash,
+                                 void* value)
+  {
+    for (size_t i = hash & t->mask;; i = (i + 1) & t->mask) {
+      entry& curr = t->entries[i];
+      if (curr.name.load(std::memory_order_relaxed) == nullptr) {
+        curr.name_len = name_len;
+        curr.hash = hash;
+        curr.value = value;
+        curr.name.store(name, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  inline table* grow(table* old)
+  {
+    size_t capacity = old ? (old->mask + 1) * 2 : initial_capacity;
+    auto next = std::make_unique<table>(capacity);
+    if (old) {
+      for (size_t i = 0; i <= old->mask; i++) {
+        const entry& curr = old->entries[i];
+        const char* curr_name = curr.name.load(std::memory_order_relaxed);
+        if (curr_name != nullptr) {
+          insert_into(
+            next.get(), curr_name, curr.name_len, curr.hash, curr.value);
+        }
+      }
+    }
+    table* ret = next.get();
+    tables.emplace_back(std::move(next));
+    current.store(ret, std::memory_order_release);
+    return ret;
+  }
+
+public:
+  /**
+   * @brief Look up a cached symbol. This is lock-free and does not allocate.
+   *
+   * @param name The name of the symbol.
+   * @param[out] value The cached pointer, if found.
+   * @return true if the symbol was cached.
+   */
+  inline bool find(std::string_view name, void*& value) const
+  {
+    const table* t = current.load(std::memory_order_acquire);
+    if (t == nullptr) {
+      return false;
+    }
+    const entry* found = find_in(t, name, get_hash(name));
+    if (found == nullptr) {
+      return false;
+    }
+    value = found->value;
+    return true;
+  }
+
+  /**
+   * @brief Add a symbol to the cache. If another thread cached the same
+   * symbol first, the existing entry is kept.
+   *
+   * @param name The name of the symbol. This is copied by the cache.
+   * @param value The pointer to cache.
+   */
+  inline void insert(std::string_view name, void* value)
+  {
+    size_t hash = get_hash(name);
+
+    RLBOX_ACQUIRE_UNIQUE_GUARD(lock, write_lock);
+    table* t = current.load(std::memory_order_relaxed);
+    if (t != nullptr && find_in(t, name, hash) != nullptr) {
+      return;
+    }
+
+    // Keep the load factor at or below 1/2 so probe sequences stay short
+    if (t == nullptr || (count + 1) * 2 > t->mask + 1) {
+      t = grow(t);
+    }
+
+    std::unique_ptr<char[]> name_copy(new char[name.size() + 1]);
+    std::memcpy(name_copy.get(), name.data(), name.size());
+    name_copy[name.size()] = '\0';
+    insert_into(t, name_copy.get(), name.size(), hash, value);
+    names.emplace_back(std::move(name_copy));
+    count++;
+  }
+
+  /**
+   * @brief Remove all cached symbols. Unlike find and insert, this must not
+   * be called concurrently with any other operation on the cache.
+   */
+  inline void clear()
+  {
+    RLBOX_ACQUIRE_UNIQUE_GUARD(lock, write_lock);
+    current.store(nullptr, std::memory_order_release);
+    tables.clear();
+    names.clear();
+    count = 0;
+  }
+};
+
+}
@@ -0,0 +1,952 @@
+#pragma once
+// IWYU pragma: private, include "rlbox.hpp"
+// IWYU pragma: friend "rlbox_.*\.hpp"
+
+#ifdef RLBOX_MEASURE_TRANSITION_TIMES
+#  include <atomic>
+#  include <chrono>
+#  include <cstdint>
+#  include <limits>
+#  include <sstream>
+#  include <string>
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+#    include <unordered_map>
+#  endif
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+#    include <cstddef>
+#    include <memory>
+#  endif
+#  include <vector>
+#  ifndef RLBOX_USE_CUSTOM_SHARED_LOCK
+#    include <shared_mutex>
+#  endif
+#  if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||         \
+    defined(_M_IX86)
+#    define RLBOX_TRANSITION_TIMES_HAS_TSC
+#    if defined(_MSC_VER)
+#      include <intrin.h>
+#    else
+#      include <cpuid.h>
+#      include <x86intrin.h>
+#    endif
+#  endif
+#endif
+
+#include "rlbox_helpers.hpp"
+
+namespace rlbox {
+
+#if defined(RLBOX_MEASURE_TRANSITION_TIMES) ||                                 \
+  defined(RLBOX_TRANSITION_ACTION_OUT) || defined(RLBOX_TRANSITION_ACTION_IN)
+enum class rlbox_transition
+{
+  INVOKE,
+  CALLBACK
+};
+#endif
+#ifdef RLBOX_MEASURE_TRANSITION_TIMES
+struct rlbox_transition_timing
+{
+  rlbox_transition invoke;
+  const char* name;
+  void* ptr;
+  int64_t time;
+
+  std::string to_string()
+  {
+    std::ostringstream ret;
+    if (invoke == rlbox_transition::INVOKE) {
+      ret << name;
+    } else {
+      ret << "Callback " << ptr;
+    }
+    ret << " : " << time << "\n";
+
+    return ret.str();
+  }
+};
+
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+/**
+ * @brief Latency summary of a single sandboxed function (for invokes) or a
+ * single callback (for callbacks). Latencies are in nanoseconds and
+ * percentiles are accurate to within 12.5%.
+ */
+struct rlbox_transition_latency_stats
+{
+  rlbox_transition invoke;
+  const char* name;
+  void* ptr;
+  uint64_t count;
+  int64_t p50;
+  int64_t p99;
+  int64_t max;
+};
+#  endif
+
+/**
+ * @brief Clock used to measure transitions by default. It reads
+ * std::chrono::high_resolution_clock and has no calibration.
+ *
+ * A clock policy is any type with the static functions
+ * ```
+ * uint64_t now();
+ * int64_t to_ns(uint64_t ticks);
+ * void calibrate();
+ * ```
+ * and is selected by defining RLBOX_TRANSITION_TIMES_CLOCK to its name.
+ */
+struct rlbox_transition_chrono_clock
+{
+  static inline uint64_t now()
+  {
+    auto ticks = std::chrono::high_resolution_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(ticks.count());
+  }
+
+  static inline int64_t to_ns(uint64_t ticks)
+  {
+    using T_Duration = std::chrono::high_resolution_clock::duration;
+    auto duration = T_Duration(static_cast<T_Duration::rep>(ticks));
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+      .count();
+  }
+
+  static inline void calibrate() {}
+};
+
+#  ifdef RLBOX_TRANSITION_TIMES_HAS_TSC
+/**
+ * @brief Clock that reads the CPU's time stamp counter, which is much cheaper
+ * than the chrono clocks. The counter's frequency is calibrated against
+ * std::chrono::steady_clock once, the first time a sandbox is created. This
+ * requires an invariant TSC, i.e. one that ticks at a constant rate
+ * regardless of CPU frequency scaling and sleep states.
+ */
+struct rlbox_transition_tsc_clock
+{
+  static inline uint64_t now()
+  {
+    // rdtscp waits for prior instructions to complete, and the fence stops
+    // later instructions from starting before the counter is read
+    unsigned int aux;
+    uint64_t ret = __rdtscp(&aux);
+    _mm_lfence();
+    return ret;
+  }
+
+  static inline int64_t to_ns(uint64_t ticks)
+  {
+    return static_cast<int64_t>(static_cast<double>(ticks) *
+                                get_ns_per_tick());
+  }
+
+  static inline void calibrate() { get_ns_per_tick(); }
+
+private:
+  static inline bool has_invariant_tsc()
+  {
+    unsigned int regs[4] = { 0, 0, 0, 0 };
+#    if defined(_MSC_VER)
+    int max_regs[4];
+    __cpuid(max_regs, 0x80000000);
+    if (static_cast<unsigned int>(max_regs[0]) < 0x80000007) {
+      return false;
+    }
+    __cpuid(reinterpret_cast<int*>(regs), 0x80000007);
+#    else
+    if (!__get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3])) {
+      return false;
+    }
+#    endif
+    const unsigned int invariant_tsc_bit = 1u << 8;
+    return (regs[3] & invariant_tsc_bit) != 0;
+  }
+
+  static inline double measure_ns_per_tick()
+  {
+    detail::dynamic_check(has_invariant_tsc(),
+                          "rlbox_transition_tsc_clock requires a CPU with an "
+                          "invariant TSC");
+
+    using std::chrono::steady_clock;
+    const auto calibration_time = std::chrono::milliseconds(2);
+    auto start_time = steady_clock::now();
+    auto start_ticks = now();
+    auto end_time = start_time;
+    while (end_time - start_time < calibration_time) {
+      end_time = steady_clock::now();
+    }
+    auto end_ticks = now();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                                   start_time)
+                .count();
+    return static_cast<double>(ns) /
+           static_cast<double>(end_ticks - start_ticks);
+  }
+
+  static inline double get_ns_per_tick()
+  {
+    static const double ns_per_tick = measure_ns_per_tick();
+    return ns_per_tick;
+  }
+};
+#  endif
+
+#  if defined(RLBOX_TRANSITION_TIMES_RING_SIZE) &&                              \
+    !defined(RLBOX_TRANSITION_TIMES_MAX_RECORDS)
+#    define RLBOX_TRANSITION_TIMES_MAX_RECORDS 1048576
+#  endif
+
+#  ifndef RLBOX_TRANSITION_TIMES_CLOCK
+#    define RLBOX_TRANSITION_TIMES_CLOCK ::rlbox::rlbox_transition_chrono_clock
+#  endif
+
+namespace detail {
+
+  /**
+   * @brief The smallest time the clock reports for an empty interval. This is
+   * subtracted from every measurement so that the time spent reading the
+   * clock is not attributed to the transition.
+   */
+  template<typename T_Clock>
+  inline int64_t get_transition_clock_overhead_ns()
+  {
+    static const int64_t overhead = [] {
+      T_Clock::calibrate();
+      // Warm up the clock. The first calls are usually slow
+      for (int i = 0; i < 10; i++) {
+        auto val = T_Clock::now();
+        RLBOX_UNUSED(val);
+      }
+      int64_t ret = std::numeric_limits<int64_t>::max();
+      for (int i = 0; i < 1000; i++) {
+        auto start = T_Clock::now();
+        auto end = T_Clock::now();
+        auto ns = T_Clock::to_ns(end - start);
+        if (ns < ret) {
+          ret = ns;
+        }
+      }
+      return ret;
+    }();
+    return overhead;
+  }
+
+  inline void calibrate_transition_clock()
+  {
+    get_transition_clock_overhead_ns<RLBOX_TRANSITION_TIMES_CLOCK>();
+  }
+
+#  ifdef RLBOX_TRANSITION_TIMES_SAMPLE_RATE
+  static_assert(RLBOX_TRANSITION_TIMES_SAMPLE_RATE >= 1,
+                "RLBOX_TRANSITION_TIMES_SAMPLE_RATE should be at least 1");
+  // Each sampled transition stands in for this many transitions
+  static const constexpr uint64_t transition_times_sample_weight =
+    RLBOX_TRANSITION_TIMES_SAMPLE_RATE;
+#  else
+  static const constexpr uint64_t transition_times_sample_weight = 1;
+#  endif
+
+  /**
+   * @brief Measures the time since construction with the clock selected by
+   * RLBOX_TRANSITION_TIMES_CLOCK, less the clock's overhead.
+   *
+   * If RLBOX_TRANSITION_TIMES_SAMPLE_RATE is defined, only one in every
+   * RLBOX_TRANSITION_TIMES_SAMPLE_RATE timers of a given transition kind on a
+   * thread is sampled. Timers that are not sampled do not read the clock, and
+   * should not be recorded.
+   *
+   * Each transition kind has its own countdown. With a shared countdown, a
+   * periodic mix of invokes and callbacks could make the samples always land
+   * on the same kind.
+   */
+  template<rlbox_transition T_Kind>
+  class transition_timer
+  {
+    using T_Clock = RLBOX_TRANSITION_TIMES_CLOCK;
+
+#  ifdef RLBOX_TRANSITION_TIMES_SAMPLE_RATE
+    thread_local static inline uint64_t countdown = 0;
+
+    static inline bool take_sample()
+    {
+      if (countdown == 0) {
+        countdown = transition_times_sample_weight - 1;
+        return true;
+      }
+      countdown--;
+      return false;
+    }
+
+    const bool sampled = take_sample();
+    const uint64_t start = sampled ? T_Clock::now() : 0;
+#  else
+    const uint64_t start = T_Clock::now();
+#  endif
+
+  public:
+    inline bool is_sampled() const
+    {
+#  ifdef RLBOX_TRANSITION_TIMES_SAMPLE_RATE
+      return sampled;
+#  else
+      return true;
+#  endif
+    }
+
+    inline int64_t get_elapsed_ns() const
+    {
+      auto end = T_Clock::now();
+      auto ns = T_Clock::to_ns(end - start) -
+                get_transition_clock_overhead_ns<T_Clock>();
+      return ns > 0 ? ns : 0;
+    }
+  };
+
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+  /**
+   * @brief Bounded single producer, single consumer ring of transition
+   * timings. The owning thread is the only producer, so pushing a record is a
+   * couple of relaxed loads and a release store. The consumer (the thread
+   * merging the rings) is serialized by the transition_times_recorder.
+   *
+   * When the ring is full, new records are dropped and counted rather than
+   * overwriting records the consumer may be reading.
+   *
+   * A ring is shared by its thread and its recorder, and is freed by whichever
+   * of the two releases it last. The thread releases it when it exits, and the
+   * recorder releases it once it has drained the ring of an exited thread, or
+   * when the recorder is destroyed.
+   */
+  template<size_t N>
+  class transition_times_ring
+  {
+    static_assert(N != 0 && (N & (N - 1)) == 0,
+                  "RLBOX_TRANSITION_TIMES_RING_SIZE should be a power of 2");
+
+    rlbox_transition_timing records[N];
+    std::atomic<uint64_t> write_count{ 0 };
+    std::atomic<uint64_t> read_count{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint32_t> references{ 2 };
+
+  public:
+    std::atomic<bool> thread_exited{ false };
+    std::atomic<bool> recorder_destroyed{ false };
+    transition_times_ring* next;
+
+    explicit transition_times_ring(transition_times_ring* p_next)
+      : next(p_next)
+    {}
+
+    inline void push(const rlbox_transition_timing& record)
+    {
+      auto w = write_count.load(std::memory_order_relaxed);
+      if (w - read_count.load(std::memory_order_acquire) >= N) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+        return;
+      }
+      records[w & (N - 1)] = record;
+      write_count.store(w + 1, std::memory_order_release);
+    }
+
+    template<typename T_Func>
+    inline void drain(T_Func&& consumer)
+    {
+      auto r = read_count.load(std::memory_order_relaxed);
+      auto w = write_count.load(std::memory_order_acquire);
+      for (; r != w; r++) {
+        consumer(records[r & (N - 1)]);
+      }
+      read_count.store(w, std::memory_order_release);
+    }
+
+    inline uint64_t get_dropped() const
+    {
+      return dropped.load(std::memory_order_relaxed);
+    }
+
+    inline void release()
+    {
+      if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+      }
+    }
+  };
+#  endif
+
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+  /**
+   * @brief Log-bucketed latency histogram. Each power of 2 range is split into
+   * 2^sub_bucket_bits linear sub-buckets, so every bucket covers at most 12.5%
+   * of the values it represents. Recording is O(1) and lock-free.
+   */
+  class transition_latency_histogram
+  {
+  public:
+    static const constexpr uint32_t sub_bucket_bits = 3;
+    static const constexpr uint32_t sub_bucket_count = 1 << sub_bucket_bits;
+    static const constexpr uint32_t bucket_count =
+      (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+  private:
+    std::atomic<uint64_t> buckets[bucket_count]{};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<int64_t> max{ 0 };
+
+    static inline uint32_t highest_bit(uint64_t val)
+    {
+#    if defined(__GNUC__) || defined(__clang__)
+      return 63 - static_cast<uint32_t>(__builtin_clzll(val));
+#    else
+      uint32_t ret = 0;
+      while (val >>= 1) {
+        ret++;
+      }
+      return ret;
+#    endif
+    }
+
+  public:
+    static inline uint32_t get_bucket_index(uint64_t val)
+    {
+      if (val < sub_bucket_count) {
+        return static_cast<uint32_t>(val);
+      }
+      auto exponent = highest_bit(val);
+      auto sub_bucket =
+        static_cast<uint32_t>(val >> (exponent - sub_bucket_bits)) &
+        (sub_bucket_count - 1);
+      return (exponent - sub_bucket_bits + 1) * sub_bucket_count + sub_bucket;
+    }
+
+    // The largest value that maps to the given bucket
+    static inline uint64_t get_bucket_upper_bound(uint32_t index)
+    {
+      if (index < sub_bucket_count) {
+        return index;
+      }
+      uint32_t exponent = index / sub_bucket_count + sub_bucket_bits - 1;
+      uint64_t sub_bucket = index % sub_bucket_count;
+      uint64_t shift = exponent - sub_bucket_bits;
+      uint64_t lower = (sub_bucket_count + sub_bucket) << shift;
+      return lower + ((uint64_t(1) << shift) - 1);
+    }
+
+    inline void record(int64_t time, uint64_t weight)
+    {
+      if (time < 0) {
+        time = 0;
+      }
+      auto index = get_bucket_index(static_cast<uint64_t>(time));
+      buckets[index].fetch_add(weight, std::memory_order_relaxed);
+      count.fetch_add(weight, std::memory_order_relaxed);
+      auto curr_max = max.load(std::memory_order_relaxed);
+      while (time > curr_max &&
+             !max.compare_exchange_weak(
+               curr_max, time, std::memory_order_relaxed)) {
+      }
+    }
+
+    inline uint64_t get_count() const
+    {
+      return count.load(std::memory_order_relaxed);
+    }
+
+    inline int64_t get_max() const
+    {
+      return max.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the value at the given percentile (0 to 100). The result is
+     * the upper bound of the bucket containing the percentile, capped at the
+     * largest value recorded.
+     */
+    inline int64_t get_percentile(double percentile) const
+    {
+      uint64_t total = get_count();
+      if (total == 0) {
+        return 0;
+      }
+      auto target = static_cast<uint64_t>(percentile / 100.0 * total);
+      if (target == 0) {
+        target = 1;
+      }
+      uint64_t seen = 0;
+      int64_t curr_max = get_max();
+      for (uint32_t i = 0; i < bucket_count; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+          auto bound = static_cast<int64_t>(get_bucket_upper_bound(i));
+          return bound < curr_max ? bound : curr_max;
+        }
+      }
+      return curr_max;
+    }
+
+    inline void clear()
+    {
+      for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+      }
+      count.store(0, std::memory_order_relaxed);
+      max.store(0, std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * @brief Fixed size, open addressed table of latency histograms keyed by a
+   * function or callback pointer. Slots are claimed with a CAS the first time
+   * a key is seen and are never released, so lookups need no locks. Once all
+   * slots are claimed, transitions of new keys are only counted as untracked.
+   */
+  template<size_t N>
+  class transition_latency_table
+  {
+    static_assert(
+      N != 0 && (N & (N - 1)) == 0,
+      "RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS should be a power of 2");
+
+    struct slot
+    {
+      std::atomic<void*> key{ nullptr };
+      std::atomic<const char*> name{ nullptr };
+      transition_latency_histogram histogram;
+    };
+
+    slot slots[N];
+    std::atomic<uint64_t> untracked{ 0 };
+
+    static inline size_t get_hash(void* key)
+    {
+      auto val = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+      return static_cast<size_t>((val * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    inline transition_latency_histogram* find_or_claim(void* key,
+                                                       const char* name)
+    {
+      auto start = get_hash(key);
+      for (size_t i = 0; i < N; i++) {
+        auto& curr = slots[(start + i) & (N - 1)];
+        void* curr_key = curr.key.load(std::memory_order_acquire);
+        if (curr_key == key) {
+          return &curr.histogram;
+        }
+        if (curr_key == nullptr) {
+          if (curr.key.compare_exchange_strong(
+                curr_key, key, std::memory_order_acq_rel) ||
+              curr_key == key) {
+            if (name != nullptr) {
+              curr.name.store(name, std::memory_order_release);
+            }
+            return &curr.histogram;
+          }
+        }
+      }
+      return nullptr;
+    }
+
+  public:
+    inline void record(void* key, const char* name, int64_t time, uint64_t weight)
+    {
+      auto histogram = find_or_claim(key, name);
+      if (histogram) {
+        histogram->record(time, weight);
+      } else {
+        untracked.fetch_add(weight, std::memory_order_relaxed);
+      }
+    }
+
+    inline void append_stats(rlbox_transition invoke,
+                             std::vector<rlbox_transition_latency_stats>& out)
+    {
+      for (auto& curr : slots) {
+        void* key = curr.key.load(std::memory_order_acquire);
+        auto count = curr.histogram.get_count();
+        if (key == nullptr || count == 0) {
+          continue;
+        }
+        out.push_back(rlbox_transition_latency_stats{
+          invoke,
+          curr.name.load(std::memory_order_acquire),
+          key,
+          count,
+          curr.histogram.get_percentile(50),
+          curr.histogram.get_percentile(99),
+          curr.histogram.get_max() });
+      }
+    }
+
+    inline uint64_t get_untracked() const
+    {
+      return untracked.load(std::memory_order_relaxed);
+    }
+
+    inline void clear()
+    {
+      for (auto& curr : slots) {
+        curr.histogram.clear();
+      }
+      untracked.store(0, std::memory_order_relaxed);
+    }
+  };
+#  endif
+
+  /**
+   * @brief Storage for the transition timings of a single sandbox.
+   *
+   * By default every record is appended to a vector guarded by a lock. If
+   * RLBOX_TRANSITION_TIMES_RING_SIZE is defined, each thread instead records
+   * into its own bounded ring without taking any locks, and the rings are
+   * merged into the vector lazily when the timings are queried. The merged
+   * vector then holds at most RLBOX_TRANSITION_TIMES_MAX_RECORDS records until
+   * it is cleared. Later records are counted as dropped, but still count
+   * towards the total time.
+   *
+   * If RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS is defined, every transition is
+   * instead recorded in a fixed size latency histogram for its function or
+   * callback, and only a running total of the time is kept, so recording
+   * takes no locks and memory use is fixed. Define
+   * RLBOX_TRANSITION_TIMES_KEEP_RECORDS to also keep the individual records.
+   *
+   * If RLBOX_TRANSITION_TIMES_SAMPLE_RATE is defined, only sampled transitions
+   * are recorded. The histogram counts and total time are scaled up by the
+   * sample rate to estimate the values for all transitions.
+   */
+  class transition_times_recorder
+  {
+#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
+    RLBOX_SHARED_LOCK(transition_times_lock);
+#  endif
+    std::vector<rlbox_transition_timing> transition_times;
+
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+    using T_Ring = transition_times_ring<RLBOX_TRANSITION_TIMES_RING_SIZE>;
+
+    // The rings a thread records into, keyed by recorder id. The last ring
+    // used is checked first, and the map is only searched when the thread
+    // switches between sandboxes.
+    struct thread_ring_map
+    {
+      uint64_t last_recorder_id;
+      T_Ring* last_ring;
+      std::unordered_map<uint64_t, T_Ring*> rings;
+
+      thread_ring_map()
+        : last_recorder_id(0)
+        , last_ring(nullptr)
+      {}
+
+      // Release the rings of destroyed recorders, so the map only holds
+      // entries for recorders that are alive
+      void release_orphans()
+      {
+        for (auto it = rings.begin(); it != rings.end();) {
+          auto ring = it->second;
+          if (!ring->recorder_destroyed.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
+          }
+          if (ring == last_ring) {
+            last_recorder_id = 0;
+            last_ring = nullptr;
+          }
+          it = rings.erase(it);
+          ring->release();
+        }
+      }
+
+      ~thread_ring_map()
+      {
+        for (auto& entry : rings) {
+          entry.second->thread_exited.store(true, std::memory_order_release);
+          entry.second->release();
+        }
+      }
+    };
+
+    static inline std::atomic<uint64_t> next_recorder_id{ 1 };
+    // Ids are never reused, so a thread's cached ring can never be mistaken
+    // for a ring of a recorder that was created at the same address
+    thread_local static inline thread_ring_map thread_rings;
+
+    const uint64_t recorder_id = next_recorder_id.fetch_add(1);
+    std::atomic<T_Ring*> rings{ nullptr };
+    // The sum of the merged records' times, including records that didn't fit
+    // in transition_times
+    int64_t merged_time = 0;
+    // Records merged after transition_times reached its limit
+    uint64_t dropped_on_merge = 0;
+    // Records dropped by the rings of exited threads, which have been freed
+    uint64_t dropped_by_exited = 0;
+    uint64_t dropped_on_clear = 0;
+
+    inline T_Ring* get_thread_ring()
+    {
+      auto& curr = thread_rings;
+      if (curr.last_recorder_id == recorder_id) {
+        return curr.last_ring;
+      }
+
+      T_Ring* ring = nullptr;
+      auto it = curr.rings.find(recorder_id);
+      if (it != curr.rings.end()) {
+        ring = it->second;
+      } else {
+        curr.release_orphans();
+        ring = new T_Ring(rings.load(std::memory_order_relaxed));
+        while (!rings.compare_exchange_weak(ring->next,
+                                            ring,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        curr.rings.emplace(recorder_id, ring);
+      }
+      curr.last_recorder_id = recorder_id;
+      curr.last_ring = ring;
+      return ring;
+    }
+
+    // Caller must hold transition_times_lock. Threads only push rings at the
+    // head of the list, so the head is the only link that can change
+    // concurrently.
+    void unlink_ring(T_Ring* prev, T_Ring* ring)
+    {
+      if (prev == nullptr) {
+        auto expected = ring;
+        if (rings.compare_exchange_strong(
+              expected, ring->next, std::memory_order_acq_rel)) {
+          return;
+        }
+        prev = expected;
+        while (prev->next != ring) {
+          prev = prev->next;
+        }
+      }
+      prev->next = ring->next;
+    }
+
+    // Caller must hold transition_times_lock. Rings of exited threads are
+    // drained one last time and freed.
+    template<typename T_Func>
+    void drain_rings(T_Func&& consumer)
+    {
+      T_Ring* prev = nullptr;
+      auto ring = rings.load(std::memory_order_acquire);
+      while (ring != nullptr) {
+        auto next = ring->next;
+        // Checked before draining, so every record of an exited thread is
+        // visible to the drain
+        bool exited = ring->thread_exited.load(std::memory_order_acquire);
+        ring->drain(consumer);
+        if (exited) {
+          unlink_ring(prev, ring);
+          dropped_by_exited += ring->get_dropped();
+          ring->release();
+        } else {
+          prev = ring;
+        }
+        ring = next;
+      }
+    }
+
+    uint64_t get_total_dropped()
+    {
+      uint64_t ret = dropped_by_exited + dropped_on_merge;
+      auto head = rings.load(std::memory_order_acquire);
+      for (auto ring = head; ring != nullptr; ring = ring->next) {
+        ret += ring->get_dropped();
+      }
+      return ret;
+    }
+
+    void merge_rings()
+    {
+      drain_rings([&](const rlbox_transition_timing& record) {
+        if (record.invoke == rlbox_transition::INVOKE) {
+          merged_time += record.time;
+        } else {
+          merged_time -= record.time;
+        }
+        if (transition_times.size() < RLBOX_TRANSITION_TIMES_MAX_RECORDS) {
+          transition_times.push_back(record);
+        } else {
+          dropped_on_merge++;
+        }
+      });
+    }
+#  endif
+
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+#    ifndef RLBOX_TRANSITION_TIMES_KEEP_RECORDS
+    std::atomic<int64_t> histogram_time{ 0 };
+#    endif
+
+    using T_LatencyTable =
+      transition_latency_table<RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS>;
+
+    // The tables are large, so keep them off the stack of callers that create
+    // sandboxes as locals
+    std::unique_ptr<T_LatencyTable> invoke_latencies =
+      std::make_unique<T_LatencyTable>();
+    std::unique_ptr<T_LatencyTable> callback_latencies =
+      std::make_unique<T_LatencyTable>();
+#  endif
+
+  public:
+    transition_times_recorder() = default;
+    transition_times_recorder(const transition_times_recorder&) = delete;
+    transition_times_recorder& operator=(const transition_times_recorder&) =
+      delete;
+
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+    ~transition_times_recorder()
+    {
+      // Rings of threads that are still alive are freed when the thread next
+      // adds a ring, or when it exits
+      auto ring = rings.load(std::memory_order_acquire);
+      while (ring != nullptr) {
+        auto next = ring->next;
+        ring->recorder_destroyed.store(true, std::memory_order_release);
+        ring->release();
+        ring = next;
+      }
+    }
+#  endif
+
+    inline void record(rlbox_transition invoke,
+                       const char* name,
+                       void* ptr,
+                       int64_t time)
+    {
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+      if (invoke == rlbox_transition::INVOKE) {
+        invoke_latencies->record(
+          ptr, name, time, transition_times_sample_weight);
+      } else {
+        callback_latencies->record(
+          ptr, name, time, transition_times_sample_weight);
+      }
+#  endif
+#  if defined(RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS) &&                       \
+    !defined(RLBOX_TRANSITION_TIMES_KEEP_RECORDS)
+      histogram_time.fetch_add(invoke == rlbox_transition::INVOKE ? time : -time,
+                               std::memory_order_relaxed);
+#  elif defined(RLBOX_TRANSITION_TIMES_RING_SIZE)
+      get_thread_ring()->push(
+        rlbox_transition_timing{ invoke, name, ptr, time });
+#  else
+#    ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
+      RLBOX_ACQUIRE_UNIQUE_GUARD(lock, transition_times_lock);
+#    endif
+      transition_times.push_back(
+        rlbox_transition_timing{ invoke, name, ptr, time });
+#  endif
+    }
+
+    inline std::vector<rlbox_transition_timing>& process_and_get()
+    {
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+#    ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
+      RLBOX_ACQUIRE_UNIQUE_GUARD(lock, transition_times_lock);
+#    endif
+      merge_rings();
+#  endif
+      return transition_times;
+    }
+
+    inline int64_t get_total_ns_time()
+    {
+#  if defined(RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS) &&                       \
+    !defined(RLBOX_TRANSITION_TIMES_KEEP_RECORDS)
+      return histogram_time.load(std::memory_order_relaxed) *
+             static_cast<int64_t>(transition_times_sample_weight);
+#  else
+#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
+#    ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+      RLBOX_ACQUIRE_UNIQUE_GUARD(lock, transition_times_lock);
+#    else
+      RLBOX_ACQUIRE_SHARED_GUARD(lock, transition_times_lock);
+#    endif
+#  endif
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+      merge_rings();
+      int64_t ret = merged_time;
+#  else
+      int64_t ret = 0;
+      for (auto& transition_time : transition_times) {
+        if (transition_time.invoke == rlbox_transition::INVOKE) {
+          ret += transition_time.time;
+        } else {
+          ret -= transition_time.time;
+        }
+      }
+#  endif
+      return ret * static_cast<int64_t>(transition_times_sample_weight);
+#  endif
+    }
+
+    inline void clear()
+    {
+#  ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
+      RLBOX_ACQUIRE_UNIQUE_GUARD(lock, transition_times_lock);
+#  endif
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+      drain_rings([](const rlbox_transition_timing&) {});
+      merged_time = 0;
+      dropped_on_clear = get_total_dropped();
+#  endif
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+      invoke_latencies->clear();
+      callback_latencies->clear();
+#    ifndef RLBOX_TRANSITION_TIMES_KEEP_RECORDS
+      histogram_time.store(0, std::memory_order_relaxed);
+#    endif
+#  endif
+      transition_times.clear();
+    }
+
+    /**
+     * @brief The number of records that were dropped as a thread's ring was
+     * full or the merged records reached RLBOX_TRANSITION_TIMES_MAX_RECORDS,
+     * since the last call to clear(). Always 0 if
+     * RLBOX_TRANSITION_TIMES_RING_SIZE is not defined.
+     */
+    inline uint64_t get_dropped()
+    {
+#  ifdef RLBOX_TRANSITION_TIMES_RING_SIZE
+#    ifndef RLBOX_SINGLE_THREADED_INVOCATIONS
+      RLBOX_ACQUIRE_SHARED_GUARD(lock, transition_times_lock);
+#    endif
+      return get_total_dropped() - dropped_on_clear;
+#  else
+      return 0;
+#  endif
+    }
+
+#  ifdef RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS
+    inline std::vector<rlbox_transition_latency_stats> get_latency_stats()
+    {
+      std::vector<rlbox_transition_latency_stats> ret;
+      invoke_latencies->append_stats(rlbox_transition::INVOKE, ret);
+      callback_latencies->append_stats(rlbox_transition::CALLBACK, ret);
+      return ret;
+    }
+
+    inline uint64_t get_untracked_latency_count()
+    {
+      return invoke_latencies->get_untracked() +
+             callback_latencies->get_untracked();
+    }
+#  endif
+  };
+
+}
+#endif
+
+}
@@ -34,9 +34,21 @@ class rlbox_sandbox;
 template<typename T, typename T_Sbx>
 class sandbox_callback;
 
+template<typename T, typename T_Sbx>
+class sandbox_function;
+
+template<typename T, typename T_Sbx, typename... T_Args>
+class sandbox_function_call;
+
 template<typename T, typename T_Sbx>
 class app_pointer;
 
+template<typename T_Sbx>
+class sandbox_slab_allocator;
+
+template<typename T_Sbx>
+class sandbox_frame;
+
 class rlbox_noop_sandbox;
 
 class rlbox_dylib_sandbox;
@@ -53,6 +65,9 @@ class rlbox_dylib_sandbox;
   using sandbox_callback_##SBXNAME =                                           \
     rlbox::sandbox_callback<T, rlbox_##SBXNAME##_sandbox_type>;                \
   template<typename T>                                                         \
+  using sandbox_function_##SBXNAME =                                           \
+    rlbox::sandbox_function<T, rlbox_##SBXNAME##_sandbox_type>;                \
+  template<typename T>                                                         \
   using tainted_##SBXNAME = rlbox::tainted<T, rlbox_##SBXNAME##_sandbox_type>; \
   template<typename T>                                                         \
   using tainted_opaque_##SBXNAME =                                             \
@@ -74,6 +89,9 @@ class rlbox_dylib_sandbox;
   using sandbox_callback_##SBXNAME =                                           \
     rlbox::sandbox_callback<T, rlbox_##SBXNAME##_sandbox_type>;                \
   template<typename T>                                                         \
+  using sandbox_function_##SBXNAME =                                           \
+    rlbox::sandbox_function<T, rlbox_##SBXNAME##_sandbox_type>;                \
+  template<typename T>                                                         \
   using tainted_##SBXNAME = rlbox::tainted<T, rlbox_##SBXNAME##_sandbox_type>; \
   template<typename T>                                                         \
   using tainted_opaque_##SBXNAME =                                             \
@@ -0,0 +1,190 @@
+#pragma once
+// IWYU pragma: private, include "rlbox.hpp"
+// IWYU pragma: friend "rlbox_.*\.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "rlbox_helpers.hpp"
+
+namespace rlbox {
+
+/**
+ * @brief A bump allocator for data copied out of a sandbox with the arena
+ * overloads of copy_and_verify, copy_and_verify_range and
+ * copy_and_verify_string. Everything allocated from the arena is freed at
+ * once by reset, which keeps the chunks for reuse, so once the arena has
+ * grown to the size of a request, copying out the data of later requests
+ * doesn't touch the heap.
+ *
+ * Memory handed out by the arena is not initialized and destructors are
+ * never run, so it should only hold trivially destructible values. This class
+ * is not thread-safe.
+ */
+class verify_arena
+{
+  // Chunks of chunk_size bytes. Chunks after current are unused since the
+  // last reset
+  std::vector<std::unique_ptr<char[]>> chunks;
+  size_t current = 0;
+  size_t offset = 0;
+  // Allocations too large for a chunk, which are freed on reset
+  std::vector<std::unique_ptr<char[]>> large_allocations;
+  size_t chunk_size;
+
+  static inline char* align_up(char* p, size_t align)
+  {
+    auto val = reinterpret_cast<uintptr_t>(p);
+    auto aligned = (val + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    return p + (aligned - val);
+  }
+
+  // Returns null if the current chunk doesn't have room
+  inline void* allocate_from_current(size_t size, size_t align)
+  {
+    char* curr = chunks[current].get();
+    auto base = reinterpret_cast<uintptr_t>(curr);
+    auto start = static_cast<size_t>(
+      ((base + offset + align - 1) & ~static_cast<uintptr_t>(align - 1)) -
+      base);
+    if (start > chunk_size || size > chunk_size - start) {
+      return nullptr;
+    }
+    offset = start + size;
+    return curr + start;
+  }
+
+public:
+  static constexpr size_t default_chunk_size = 16 * 1024;
+
+  /**
+   * @brief Construct an arena that gets memory from the heap in chunks of the
+   * given size. No memory is allocated until the first allocation.
+   */
+  explicit verify_arena(size_t p_chunk_size = default_chunk_size)
+    : chunk_size(p_chunk_size)
+  {}
+
+  verify_arena(const verify_arena&) = delete;
+  verify_arena& operator=(const verify_arena&) = delete;
+
+  /**
+   * @brief Allocate uninitialized memory that lives until the next reset.
+   *
+   * @param size The size of the allocation in bytes.
+   * @param align The alignment of the allocation, which must be a power of
+   * two.
+   */
+  inline void* allocate(size_t size,
+                        size_t align = alignof(std::max_align_t))
+  {
+    detail::dynamic_check(align != 0 && (align & (align - 1)) == 0,
+                          "verify_arena alignment must be a power of two");
+    detail::dynamic_check(size <= std::numeric_limits<size_t>::max() - align,
+                          "Allocation is too large for verify_arena");
+
+    if (size + align > chunk_size) {
+      large_allocations.emplace_back(new char[size + align]);
+      return align_up(large_allocations.back().get(), align);
+    }
+
+    for (; current < chunks.size(); current++, offset = 0) {
+      void* ret = allocate_from_current(size, align);
+      if (ret != nullptr) {
+        return ret;
+      }
+    }
+
+    chunks.emplace_back(new char[chunk_size]);
+    return allocate_from_current(size, align);
+  }
+
+  /**
+   * @brief Allocate uninitialized memory for count values of type T that
+   * lives until the next reset.
+   */
+  template<typename T>
+  inline T* allocate_array(size_t count)
+  {
+    detail::dynamic_check(count <= std::numeric_limits<size_t>::max() /
+                                     sizeof(T),
+                          "Allocation is too large for verify_arena");
+    return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+  }
+
+  /**
+   * @brief Free everything allocated from the arena. The chunks are kept and
+   * reused by later allocations.
+   */
+  inline void reset()
+  {
+    current = 0;
+    offset = 0;
+    large_allocations.clear();
+  }
+
+  /**
+   * @brief Free everything allocated from the arena, and return its chunks to
+   * the heap.
+   */
+  inline void release()
+  {
+    reset();
+    chunks.clear();
+  }
+
+  /**
+   * @brief The number of bytes held in chunks, not counting allocations too
+   * large for a chunk.
+   */
+  inline size_t capacity() const noexcept { return chunks.size() * chunk_size; }
+
+  /**
+   * @brief An allocator for standard containers that allocates from the
+   * arena. Deallocation does nothing, the memory is freed by reset.
+   */
+  template<typename T>
+  class allocator
+  {
+    template<typename T2>
+    friend class allocator;
+
+    verify_arena* arena;
+
+  public:
+    using value_type = T;
+
+    allocator(verify_arena& p_arena) noexcept
+      : arena(&p_arena)
+    {}
+
+    template<typename T2>
+    allocator(const allocator<T2>& other) noexcept
+      : arena(other.arena)
+    {}
+
+    inline T* allocate(size_t count)
+    {
+      return arena->template allocate_array<T>(count);
+    }
+
+    inline void deallocate(T*, size_t) noexcept {}
+
+    template<typename T2>
+    inline bool operator==(const allocator<T2>& other) const noexcept
+    {
+      return arena == other.arena;
+    }
+
+    template<typename T2>
+    inline bool operator!=(const allocator<T2>& other) const noexcept
+    {
+      return arena != other.arena;
+    }
+  };
+};
+
+}
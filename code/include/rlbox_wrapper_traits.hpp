@@ -168,4 +168,49 @@ constexpr bool has_member_using_needs_internal_lookup_symbol_v =
   detail_has_member_using_needs_internal_lookup_symbol::
     has_member_using_needs_internal_lookup_symbol<T>::value;
 
-}
\ No newline at end of file
+namespace detail_has_member_using_can_invoke_batch {
+  template<class T, class Enable = void>
+  struct has_member_using_can_invoke_batch : std::false_type
+  {};
+
+  template<class T>
+  struct has_member_using_can_invoke_batch<
+    T,
+    std::void_t<typename T::can_invoke_batch>> : std::true_type
+  {};
+}
+
+template<class T>
+constexpr bool has_member_using_can_invoke_batch_v =
+  detail_has_member_using_can_invoke_batch::has_member_using_can_invoke_batch<
+    T>::value;
+
+namespace detail_has_member_using_abi_matches_app {
+  template<class T, class Enable = void>
+  struct has_member_using_abi_matches_app : std::false_type
+  {};
+
+  template<class T>
+  struct has_member_using_abi_matches_app<
+    T,
+    std::void_t<typename T::abi_matches_app>> : std::true_type
+  {};
+}
+
+template<class T>
+constexpr bool has_member_using_abi_matches_app_v =
+  detail_has_member_using_abi_matches_app::has_member_using_abi_matches_app<
+    T>::value;
+
+// Whether the sandbox represents primitives and pointers exactly as the
+// application does, so values can cross the boundary without conversion
+template<class T_Sbx>
+constexpr bool is_abi_identical_v =
+  has_member_using_abi_matches_app_v<T_Sbx> &&
+  std::is_same_v<typename T_Sbx::T_LongLongType, long long> &&
+  std::is_same_v<typename T_Sbx::T_LongType, long> &&
+  std::is_same_v<typename T_Sbx::T_IntType, int> &&
+  std::is_same_v<typename T_Sbx::T_ShortType, short> &&
+  std::is_same_v<typename T_Sbx::T_PointerType, void*>;
+
+}
@@ -116,4 +116,43 @@ TEST_CASE(
   const int64_t c_arr[4]{ 1, std::numeric_limits<int64_t>::max(), 3, 4 };
   int32_t dest[4]{}; // NOLINT
   REQUIRE_THROWS(convert_type_fundamental_or_array(dest, c_arr));
-}
\ No newline at end of file
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("convert_range_fundamental operates correctly", "[convert]")
+{
+  using rlbox::detail::convert_range_fundamental;
+
+  const int32_t c_arr_1[4]{ -1, 2, -3, 4 }; // NOLINT
+  const int64_t c_arr_2[4]{ -1, 2, -3, 4 }; // NOLINT
+
+  {
+    int32_t dest[4]{}; // NOLINT
+    convert_range_fundamental(&dest[0], &c_arr_1[0], 4);
+    REQUIRE(std::memcmp(&dest, &c_arr_1, sizeof(dest)) == 0);
+  }
+
+  {
+    int64_t dest[4]{}; // NOLINT
+    convert_range_fundamental(&dest[0], &c_arr_1[0], 4);
+    REQUIRE(std::memcmp(&dest, &c_arr_2, sizeof(dest)) == 0);
+  }
+
+  {
+    int32_t dest[4]{}; // NOLINT
+    convert_range_fundamental(&dest[0], &c_arr_2[0], 4);
+    REQUIRE(std::memcmp(&dest, &c_arr_1, sizeof(dest)) == 0);
+  }
+
+  {
+    // NOLINTNEXTLINE
+    const int64_t c_arr_3[4]{ 1, 2, 3, std::numeric_limits<int64_t>::max() };
+    int32_t dest[4]{}; // NOLINT
+    REQUIRE_THROWS(convert_range_fundamental(&dest[0], &c_arr_3[0], 4));
+  }
+
+  {
+    uint32_t dest[4]{}; // NOLINT
+    REQUIRE_THROWS(convert_range_fundamental(&dest[0], &c_arr_1[0], 4));
+  }
+}
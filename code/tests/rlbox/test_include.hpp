@@ -48,6 +48,15 @@ struct testVarietyStruct
   CallbackType fnArray[8];                               // NOLINT
 };
 
+struct testPlainStruct
+{
+  unsigned long fieldLong; // NOLINT
+  const char* fieldString; // NOLINT
+  unsigned int fieldBool;  // NOLINT
+  char fieldFixedArr[8];   // NOLINT
+  void* voidPtr;           // NOLINT
+};
+
 namespace rlbox {
 class rlbox_test_sandbox;
 }
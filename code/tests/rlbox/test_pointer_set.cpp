@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "test_include.hpp"
+
+using rlbox::detail::fixed_pointer_map;
+using rlbox::detail::pointer_set;
+
+static const void* get_pointer(size_t i)
+{
+  return reinterpret_cast<const void*>(static_cast<uintptr_t>(i + 1) * 16);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test pointer set operations", "[pointer set]")
+{
+  pointer_set set;
+  REQUIRE(!set.contains(get_pointer(0)));
+  REQUIRE(!set.erase(get_pointer(0)));
+
+  REQUIRE(set.insert(get_pointer(0)));
+  REQUIRE(!set.insert(get_pointer(0)));
+  REQUIRE(set.contains(get_pointer(0)));
+  REQUIRE(set.size() == 1);
+
+  REQUIRE(set.erase(get_pointer(0)));
+  REQUIRE(!set.contains(get_pointer(0)));
+  REQUIRE(set.size() == 0);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test pointer set matches std::set", "[pointer set]")
+{
+  // Interleave inserts and erases so that erases shift back entries in long
+  // probe runs
+  pointer_set set;
+  std::set<const void*> expected;
+  const size_t count = 2000;
+  for (size_t i = 0; i < count; i++) {
+    auto p = get_pointer((i * 7919) % 512);
+    if (i % 3 == 2) {
+      REQUIRE(set.erase(p) == (expected.erase(p) == 1));
+    } else {
+      REQUIRE(set.insert(p) == expected.insert(p).second);
+    }
+    REQUIRE(set.size() == expected.size());
+  }
+
+  for (size_t i = 0; i < 512; i++) {
+    auto p = get_pointer(i);
+    REQUIRE(set.contains(p) == (expected.count(p) == 1));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test fixed pointer map matches std::map", "[pointer set]")
+{
+  const size_t capacity = 64;
+  fixed_pointer_map<size_t, capacity> map;
+  std::map<const void*, size_t> expected;
+  size_t value = 0;
+  REQUIRE(!map.erase(get_pointer(0), value));
+
+  for (size_t i = 0; i < 2000; i++) {
+    auto p = get_pointer((i * 7919) % 128);
+    auto found = expected.find(p);
+    if (found != expected.end()) {
+      REQUIRE(map.erase(p, value));
+      REQUIRE(value == found->second);
+      expected.erase(found);
+    } else if (expected.size() < capacity) {
+      map.insert(p, i);
+      expected[p] = i;
+    }
+  }
+
+  for (size_t i = 0; i < 128; i++) {
+    auto p = get_pointer(i);
+    auto found = expected.find(p);
+    REQUIRE(map.erase(p, value) == (found != expected.end()));
+    if (found != expected.end()) {
+      REQUIRE(value == found->second);
+    }
+  }
+}
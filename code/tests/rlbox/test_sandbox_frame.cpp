@@ -0,0 +1,141 @@
+// NOLINTNEXTLINE
+#define RLBOX_USE_STATIC_CALLS() rlbox_noop_sandbox_lookup_symbol
+
+#include <cstdint>
+#include <thread>
+
+#include "test_include.hpp"
+
+using rlbox::rlbox_noop_sandbox;
+using RL = rlbox::rlbox_sandbox<rlbox_noop_sandbox>;
+using Frame = rlbox::sandbox_frame<rlbox_noop_sandbox>;
+
+template<typename T>
+static uintptr_t get_address(rlbox::tainted<T*, rlbox_noop_sandbox> p)
+{
+  return reinterpret_cast<uintptr_t>(p.UNSAFE_unverified());
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox frame allocation", "[sandbox frame]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+
+  uintptr_t first = 0;
+  {
+    Frame frame(sandbox);
+    auto p1 = frame.malloc_in_sandbox<char>(3);
+    auto p2 = frame.malloc_in_sandbox<uint64_t>(2);
+    REQUIRE(p1 != nullptr);
+    REQUIRE(p2 != nullptr);
+    first = get_address(p1);
+    REQUIRE(get_address(p2) % alignof(uint64_t) == 0);
+    REQUIRE(get_address(p2) >= first + 3);
+
+    p2[1] = 2;
+    REQUIRE(p2[1].UNSAFE_unverified() == 2);
+
+    // Nested frames continue from the outer frame
+    uintptr_t inner_first = 0;
+    {
+      Frame inner(sandbox);
+      auto p3 = inner.malloc_in_sandbox<uint32_t>();
+      inner_first = get_address(p3);
+      REQUIRE(inner_first >= get_address(p2) + 2 * sizeof(uint64_t));
+      REQUIRE_THROWS(frame.malloc_in_sandbox<uint32_t>());
+    }
+    REQUIRE(get_address(frame.malloc_in_sandbox<uint32_t>()) == inner_first);
+
+    // Allocations too large for the scratch region fall back to
+    // malloc_in_sandbox
+    auto large = frame.malloc_in_sandbox<char>(RLBOX_SANDBOX_SCRATCH_SIZE);
+    REQUIRE(large != nullptr);
+    large[RLBOX_SANDBOX_SCRATCH_SIZE - 1] = 'a';
+  }
+
+  // Allocations are released with the frame
+  {
+    Frame frame(sandbox);
+    REQUIRE(get_address(frame.malloc_in_sandbox<char>()) == first);
+  }
+
+  // Each thread has its own scratch region
+  uintptr_t other = 0;
+  std::thread t([&] {
+    Frame frame(sandbox);
+    other = get_address(frame.malloc_in_sandbox<char>());
+  });
+  t.join();
+  REQUIRE(other != 0);
+  REQUIRE(other != first);
+
+  // The region of a thread that exited is reused by the next thread
+  uintptr_t reused = 0;
+  std::thread t2([&] {
+    Frame frame(sandbox);
+    reused = get_address(frame.malloc_in_sandbox<char>());
+  });
+  t2.join();
+  REQUIRE(reused == other);
+
+  sandbox.destroy_sandbox();
+
+  // Frames still allocate after the sandbox is created again
+  sandbox.create_sandbox();
+  {
+    Frame frame(sandbox);
+    REQUIRE(frame.malloc_in_sandbox<int>() != nullptr);
+  }
+  sandbox.destroy_sandbox();
+
+  {
+    Frame frame(sandbox);
+    REQUIRE(frame.malloc_in_sandbox<int>() == nullptr);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox frames alternating between sandboxes", "[sandbox frame]")
+{
+  RL sandbox1;
+  RL sandbox2;
+  sandbox1.create_sandbox();
+  sandbox2.create_sandbox();
+
+  uintptr_t first1 = 0;
+  uintptr_t first2 = 0;
+  {
+    Frame frame1(sandbox1);
+    Frame frame2(sandbox2);
+    first1 = get_address(frame1.malloc_in_sandbox<char>());
+    first2 = get_address(frame2.malloc_in_sandbox<char>());
+  }
+  REQUIRE(first1 != first2);
+
+  // Each sandbox keeps handing out the thread's same region
+  for (int i = 0; i < 4; i++) { // NOLINT
+    Frame frame1(sandbox1);
+    REQUIRE(get_address(frame1.malloc_in_sandbox<char>()) == first1);
+    Frame frame2(sandbox2);
+    REQUIRE(get_address(frame2.malloc_in_sandbox<char>()) == first2);
+  }
+
+  sandbox1.destroy_sandbox();
+
+  // The region of the destroyed sandbox doesn't affect the other one
+  {
+    Frame frame2(sandbox2);
+    REQUIRE(get_address(frame2.malloc_in_sandbox<char>()) == first2);
+  }
+  sandbox1.create_sandbox();
+  {
+    Frame frame1(sandbox1);
+    REQUIRE(frame1.malloc_in_sandbox<char>() != nullptr);
+    Frame frame2(sandbox2);
+    REQUIRE(get_address(frame2.malloc_in_sandbox<char>()) == first2);
+  }
+
+  sandbox1.destroy_sandbox();
+  sandbox2.destroy_sandbox();
+}
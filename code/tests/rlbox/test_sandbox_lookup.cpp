@@ -0,0 +1,202 @@
+#include <cstdint>
+#include <future>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "test_sandbox_lookup.hpp"
+
+// NOLINTNEXTLINE
+TEST_CASE("Test sandbox lookup from example pointer", "[sandbox lookup]")
+{
+  const size_t count = 64;
+  auto sandboxes = create_sandboxes(count);
+
+  for (size_t i = 0; i < count; i++) {
+    REQUIRE(lookup_function(*sandboxes[i]) == get_fake_function(i));
+  }
+
+  // Destroy every other sandbox, the rest should still be found
+  for (size_t i = 0; i < count; i += 2) {
+    sandboxes[i]->destroy_sandbox();
+  }
+  for (size_t i = 1; i < count; i += 2) {
+    REQUIRE(lookup_function(*sandboxes[i]) == get_fake_function(i));
+  }
+
+  for (size_t i = 1; i < count; i += 2) {
+    sandboxes[i]->destroy_sandbox();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test sandbox lookup after a sandbox is destroyed",
+          "[sandbox lookup]")
+{
+  auto first = create_sandboxes(1);
+  REQUIRE(lookup_function(*first[0]) == get_fake_function(0));
+
+  // The new sandbox may reuse the memory of the destroyed one. The lookup
+  // remembered from the destroyed sandbox must not be used.
+  first[0]->destroy_sandbox();
+  auto second = std::make_unique<RL>();
+  second->create_sandbox();
+  second->get_sandboxed_pointer<CallbackType>(get_fake_function(1));
+  second->get_sandboxed_pointer<CallbackType>(get_fake_function(1));
+  REQUIRE(lookup_function(*second) == get_fake_function(1));
+
+  second->destroy_sandbox();
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test sandbox lookup after registrations without lookups",
+          "[sandbox lookup]")
+{
+  // Registrations are only merged into the sorted index by lookups, so these
+  // all start out pending, and the removed ones are left as stale entries
+  const size_t count = 256;
+  auto sandboxes = create_sandboxes(count);
+  for (size_t i = 0; i < count; i += 2) {
+    sandboxes[i]->destroy_sandbox();
+  }
+  auto more = create_sandboxes(count / 2);
+
+  for (size_t i = 1; i < count; i += 2) {
+    REQUIRE(lookup_function(*sandboxes[i]) == get_fake_function(i));
+  }
+  for (size_t i = 0; i < more.size(); i++) {
+    REQUIRE(lookup_function(*more[i]) == get_fake_function(i));
+  }
+
+  for (size_t i = 1; i < count; i += 2) {
+    sandboxes[i]->destroy_sandbox();
+  }
+  for (auto& sandbox : more) {
+    sandbox->destroy_sandbox();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test sandbox lookup while sandboxes are created and destroyed",
+          "[sandbox lookup]")
+{
+  auto long_lived = create_sandboxes(64);
+
+  const int thread_count = 4;
+  const int iterations = 2000;
+  std::vector<uint64_t> mismatches(thread_count, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < iterations; i++) {
+        auto curr = create_sandboxes(1);
+        if (lookup_function(*curr[0]) != get_fake_function(0)) {
+          mismatches[t]++;
+        }
+        size_t idx = static_cast<size_t>(i) % long_lived.size();
+        if (lookup_function(*long_lived[idx]) != get_fake_function(idx)) {
+          mismatches[t]++;
+        }
+        curr[0]->destroy_sandbox();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int t = 0; t < thread_count; t++) {
+    REQUIRE(mismatches[t] == 0);
+  }
+  for (auto& sandbox : long_lived) {
+    sandbox->destroy_sandbox();
+  }
+}
+
+namespace {
+// A sandbox whose memory can grow after it is registered, as with wasm2c's
+// memory.grow
+struct growable_sandbox
+{
+  char* base;
+  size_t size;
+
+  void* get_memory_location() { return base; }
+  size_t get_total_memory() { return size; }
+  bool is_pointer_in_sandbox_memory(const void* p)
+  {
+    auto val = reinterpret_cast<uintptr_t>(p);
+    auto start = reinterpret_cast<uintptr_t>(base);
+    return val >= start && val - start < size;
+  }
+};
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test sandbox lookup in memory grown after registration",
+          "[sandbox lookup]")
+{
+  static rlbox::detail::sandbox_index<growable_sandbox> index;
+  const size_t capacity = 4096;
+  static char memory[2 * capacity];
+
+  growable_sandbox first{ memory, capacity / 2 };
+  growable_sandbox second{ memory + capacity, capacity };
+  auto first_reg = index.add(&first);
+  auto second_reg = index.add(&second);
+
+  REQUIRE(index.find(first.base) == &first);
+  REQUIRE(index.find(first.base + first.size - 1) == &first);
+  // The byte just past the end belongs to neither sandbox
+  REQUIRE(index.find(first.base + first.size) == nullptr);
+  REQUIRE(index.find(second.base) == &second);
+
+  first.size = capacity;
+  REQUIRE(index.find(first.base + capacity / 2) == &first);
+  REQUIRE(index.find(first.base + capacity - 1) == &first);
+  REQUIRE(index.find(second.base + capacity - 1) == &second);
+
+  index.remove(first_reg);
+  index.remove(second_reg);
+  REQUIRE(index.find(first.base) == nullptr);
+  REQUIRE(index.find(second.base) == nullptr);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test sandbox lookup in an index destroyed before its readers",
+          "[sandbox lookup]")
+{
+  const size_t capacity = 4096;
+  static char memory[capacity];
+  growable_sandbox sandbox{ memory, capacity };
+
+  std::optional<rlbox::detail::sandbox_index<growable_sandbox>> index;
+  index.emplace();
+  auto reg = index->add(&sandbox);
+  REQUIRE(index->find(memory) == &sandbox);
+
+  // A thread that used the index exits after the index is destroyed
+  std::promise<void> looked_up;
+  std::promise<void> destroyed;
+  bool found = false;
+  std::thread reader([&] {
+    found = index->find(memory) == &sandbox;
+    looked_up.set_value();
+    destroyed.get_future().wait();
+  });
+  looked_up.get_future().wait();
+  index->remove(reg);
+  index.reset();
+
+  // An index at the same address doesn't reuse what threads cached for the
+  // old one
+  index.emplace();
+  REQUIRE(index->find(memory) == nullptr);
+  reg = index->add(&sandbox);
+  REQUIRE(index->find(memory) == &sandbox);
+  index->remove(reg);
+
+  destroyed.set_value();
+  reader.join();
+  REQUIRE(found);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "test_include.hpp"
+
+using RL = rlbox::rlbox_sandbox<TestSandbox>;
+
+static inline const void* get_fake_function(size_t i)
+{
+  return reinterpret_cast<const void*>((i + 1) * 16);
+}
+
+static inline void* get_example_pointer(RL& sandbox)
+{
+  return reinterpret_cast<char*>(sandbox.get_memory_location()) + 8;
+}
+
+static inline std::vector<std::unique_ptr<RL>> create_sandboxes(size_t count)
+{
+  std::vector<std::unique_ptr<RL>> ret;
+  for (size_t i = 0; i < count; i++) {
+    auto sandbox = std::make_unique<RL>();
+    sandbox->create_sandbox();
+    // Swizzling function pointers without a sandbox context looks up the
+    // sandbox from the example pointer. Give each sandbox a distinct function
+    // so we can check the right sandbox was found. Index 0 is skipped as it is
+    // treated as a null pointer.
+    sandbox->get_sandboxed_pointer<CallbackType>(get_fake_function(i));
+    auto idx = sandbox->get_sandboxed_pointer<CallbackType>(get_fake_function(i));
+    REQUIRE(idx == 1);
+    ret.emplace_back(std::move(sandbox));
+  }
+  return ret;
+}
+
+static inline void* lookup_function(RL& sandbox)
+{
+  return reinterpret_cast<void*>(
+    RL::get_unsandboxed_pointer_no_ctx<CallbackType>(
+      1, get_example_pointer(sandbox)));
+}
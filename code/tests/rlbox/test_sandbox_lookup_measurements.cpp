@@ -0,0 +1,88 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "test_sandbox_lookup.hpp"
+
+using namespace std::chrono;
+
+// NOLINTNEXTLINE
+TEST_CASE("Sandbox registration measurements", "[sandbox_lookup_measurements]")
+{
+  // Sandboxes that stay alive while others are created and destroyed
+  auto long_lived = create_sandboxes(1024);
+
+  const int total = 100000;
+  for (int thread_count : { 1, 4 }) {
+    const int per_thread = total / thread_count;
+    std::vector<std::thread> threads;
+    auto enter_time = high_resolution_clock::now();
+    for (int t = 0; t < thread_count; t++) {
+      threads.emplace_back([&]() {
+        RL sandbox;
+        for (int i = 0; i < per_thread; i++) {
+          sandbox.create_sandbox();
+          sandbox.destroy_sandbox();
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto exit_time = high_resolution_clock::now();
+
+    int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "Sandbox create and destroy time with " << thread_count
+              << " threads: " << (ns / total) << "\n";
+  }
+
+  for (auto& sandbox : long_lived) {
+    sandbox->destroy_sandbox();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Sandbox lookup measurements", "[sandbox_lookup_measurements]")
+{
+  const int iterations = 100000;
+  for (size_t count : { 16, 1024, 4096 }) {
+    auto sandboxes = create_sandboxes(count);
+
+    uint64_t mismatches = 0;
+    auto enter_time = high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      size_t idx = (static_cast<size_t>(i) * 7919) % count;
+      if (lookup_function(*sandboxes[idx]) != get_fake_function(idx)) {
+        mismatches++;
+      }
+    }
+    auto exit_time = high_resolution_clock::now();
+
+    int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "Sandbox lookup time with " << count
+              << " sandboxes: " << (ns / iterations) << "\n";
+    REQUIRE(mismatches == 0);
+
+    // Runs of lookups in the same sandbox, as when converting a struct
+    const int run_length = 16;
+    enter_time = high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      size_t idx = (static_cast<size_t>(i / run_length) * 7919) % count;
+      if (lookup_function(*sandboxes[idx]) != get_fake_function(idx)) {
+        mismatches++;
+      }
+    }
+    exit_time = high_resolution_clock::now();
+
+    ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "Sandbox repeated lookup time with " << count
+              << " sandboxes: " << (ns / iterations) << "\n";
+    REQUIRE(mismatches == 0);
+
+    for (auto& sandbox : sandboxes) {
+      sandbox->destroy_sandbox();
+    }
+  }
+}
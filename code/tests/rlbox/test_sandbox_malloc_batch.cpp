@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <tuple>
+
+#include "test_include.hpp"
+
+template<typename T>
+static uintptr_t get_address(rlbox::tainted<T*, TestSandbox> p)
+{
+  return reinterpret_cast<uintptr_t>(p.UNSAFE_unverified());
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("malloc_in_sandbox_batch layout", "[malloc batch]")
+{
+  rlbox::rlbox_sandbox<TestSandbox> sandbox;
+  sandbox.create_sandbox();
+
+  auto [pc, pl, pd] =
+    sandbox.malloc_in_sandbox_batch<char, long, double>(3, 2, 1); // NOLINT
+  REQUIRE(pc != nullptr);
+  REQUIRE(pl != nullptr);
+  REQUIRE(pd != nullptr);
+
+  // The arrays are laid out in order, each aligned for its type
+  REQUIRE(get_address(pl) % alignof(long) == 0); // NOLINT
+  REQUIRE(get_address(pd) % alignof(double) == 0);
+  REQUIRE(get_address(pl) >= get_address(pc) + 3);
+  REQUIRE(get_address(pd) >= get_address(pl) + 2 * sizeof(long)); // NOLINT
+  REQUIRE(get_address(pd) - get_address(pc) <
+          3 + 2 * sizeof(long) + alignof(long) + alignof(double)); // NOLINT
+
+  pc[2] = 'c';
+  pl[1] = -1;
+  *pd = 1.5; // NOLINT
+  REQUIRE(pc[2].UNSAFE_unverified() == 'c');
+  REQUIRE(pl[1].UNSAFE_unverified() == -1);
+  REQUIRE(pd->UNSAFE_unverified() == 1.5); // NOLINT
+
+  sandbox.free_in_sandbox_batch(std::make_tuple(pc, pl, pd));
+
+  auto many = sandbox.malloc_in_sandbox_many<uint32_t>(1, 2u, size_t(3));
+  REQUIRE(get_address(std::get<1>(many)) ==
+          get_address(std::get<0>(many)) + sizeof(uint32_t));
+  REQUIRE(get_address(std::get<2>(many)) ==
+          get_address(std::get<0>(many)) + 3 * sizeof(uint32_t));
+  sandbox.free_in_sandbox_batch(many);
+
+  REQUIRE_THROWS(sandbox.malloc_in_sandbox_batch<char, int>(1, 0));
+  REQUIRE_THROWS(sandbox.malloc_in_sandbox_many<char>(uint64_t(1) << 32));
+
+  sandbox.destroy_sandbox();
+
+  auto [pnull1, pnull2] = sandbox.malloc_in_sandbox_batch<int, char>(1, 1);
+  REQUIRE(pnull1 == nullptr);
+  REQUIRE(pnull2 == nullptr);
+}
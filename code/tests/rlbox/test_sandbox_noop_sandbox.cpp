@@ -7,6 +7,16 @@ using rlbox::rlbox_noop_sandbox;
 using rlbox::tainted;
 using RL = rlbox::rlbox_sandbox<rlbox_noop_sandbox>;
 
+// The noop sandbox with its abi_matches_app flag made inaccessible, so that
+// values take the usual conversion path
+class rlbox_noop_sandbox_converted : public rlbox_noop_sandbox
+{
+private:
+  using abi_matches_app = void;
+};
+
+using RLConverted = rlbox::rlbox_sandbox<rlbox_noop_sandbox_converted>;
+
 int GlobalVal = 0;
 static void test_func_void(int param)
 {
@@ -93,6 +103,75 @@ TEST_CASE("callback in no_op sandbox", "[no_op_sandbox]")
   sandbox.destroy_sandbox();
 }
 
+// The noop sandbox with a limit on the number of callback registrations, so
+// that registration can be made to fail
+class rlbox_noop_sandbox_limited_callbacks : public rlbox_noop_sandbox
+{
+public:
+  static inline int registrations_left = 0;
+
+protected:
+  static inline std::pair<rlbox_noop_sandbox_limited_callbacks*, void*>
+  impl_get_executed_callback_sandbox_and_key()
+  {
+    auto [sandbox, key] =
+      rlbox_noop_sandbox::impl_get_executed_callback_sandbox_and_key();
+    return std::make_pair(
+      static_cast<rlbox_noop_sandbox_limited_callbacks*>(sandbox), key);
+  }
+
+  template<typename T_Ret, typename... T_Args>
+  inline T_PointerType impl_register_callback(void* key, void* callback)
+  {
+    if (registrations_left == 0) {
+      throw std::runtime_error("Out of callback registrations");
+    }
+    registrations_left--;
+    return rlbox_noop_sandbox::impl_register_callback<T_Ret, T_Args...>(
+      key, callback);
+  }
+};
+
+using RLLimited = rlbox::rlbox_sandbox<rlbox_noop_sandbox_limited_callbacks>;
+
+template<int N>
+static tainted<int, rlbox_noop_sandbox_limited_callbacks> limited_callback(
+  RLLimited&, // NOLINT
+  tainted<int, rlbox_noop_sandbox_limited_callbacks> val)
+{
+  return val + N;
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("failed bulk callback registration in no_op sandbox",
+          "[no_op_sandbox]")
+{
+  RLLimited sandbox;
+  sandbox.create_sandbox();
+
+  // The second registration fails, which unregisters the first and releases
+  // all three callbacks
+  rlbox_noop_sandbox_limited_callbacks::registrations_left = 1;
+  REQUIRE_THROWS(sandbox.register_callbacks(
+    limited_callback<1>, limited_callback<2>, limited_callback<3>));
+
+  rlbox_noop_sandbox_limited_callbacks::registrations_left = 3;
+  auto [cb1, cb2, cb3] = sandbox.register_callbacks(
+    limited_callback<1>, limited_callback<2>, limited_callback<3>);
+  REQUIRE(!cb1.is_unregistered());
+  REQUIRE(!cb2.is_unregistered());
+  REQUIRE(!cb3.is_unregistered());
+
+  const int test_val = 5;
+  auto ret = sandbox.invoke_sandbox_function(test_invoker, cb3, test_val);
+  REQUIRE(ret.UNSAFE_unverified() == test_val + 4);
+
+  cb1.unregister();
+  cb2.unregister();
+  cb3.unregister();
+  sandbox.destroy_sandbox();
+}
+
 static void simplePointerWrite(int* ptr, int val)
 {
   *ptr = val;
@@ -112,4 +191,67 @@ TEST_CASE("incremental porting operates correctly", "[port]")
 
   REQUIRE(*ptr == test_val);
   REQUIRE(tainted_ptr.UNSAFE_unverified() == ptr);
-}
\ No newline at end of file
+}
+
+static double test_func_mixed(long a, int b, double c, short d)
+{
+  return static_cast<double>(a) * 2 + b - c + d;
+}
+
+static long* test_func_ptr_offset(long* ptr, long offset)
+{
+  return ptr + offset;
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("invoke in no_op sandbox matches the converted path and a direct "
+          "call",
+          "[no_op_sandbox]")
+{
+  REQUIRE(rlbox::detail::is_abi_identical_v<rlbox_noop_sandbox>);
+  REQUIRE(!rlbox::detail::is_abi_identical_v<rlbox_noop_sandbox_converted>);
+
+  RL sandbox;
+  sandbox.create_sandbox();
+  RLConverted converted;
+  converted.create_sandbox();
+
+  const long a = -123456789L;
+  const int b = 42;
+  const double c = 0.5;
+  const short d = -7;
+  const double expected = test_func_mixed(a, b, c, d);
+
+  auto result = sandbox.invoke_sandbox_function(test_func_mixed, a, b, c, d);
+  auto result_converted =
+    converted.invoke_sandbox_function(test_func_mixed, a, b, c, d);
+  REQUIRE(result.UNSAFE_unverified() == expected);
+  REQUIRE(result_converted.UNSAFE_unverified() == expected);
+
+  tainted<long, rlbox_noop_sandbox> tainted_a = a;
+  tainted<long, rlbox_noop_sandbox_converted> tainted_a_converted = a;
+  auto result_tainted =
+    sandbox.invoke_sandbox_function(test_func_mixed, tainted_a, b, c, d);
+  auto result_tainted_converted = converted.invoke_sandbox_function(
+    test_func_mixed, tainted_a_converted, b, c, d);
+  REQUIRE(result_tainted.UNSAFE_unverified() == expected);
+  REQUIRE(result_tainted_converted.UNSAFE_unverified() == expected);
+
+  const long count = 4;
+  auto arr = sandbox.malloc_in_sandbox<long>(count);
+  auto arr_converted = converted.malloc_in_sandbox<long>(count);
+  long* expected_ptr = test_func_ptr_offset(arr.UNSAFE_unverified(), 3);
+  long* expected_ptr_converted =
+    test_func_ptr_offset(arr_converted.UNSAFE_unverified(), 3);
+
+  auto ptr = sandbox.invoke_sandbox_function(test_func_ptr_offset, arr, 3L);
+  auto ptr_converted =
+    converted.invoke_sandbox_function(test_func_ptr_offset, arr_converted, 3L);
+  REQUIRE(ptr.UNSAFE_unverified() == expected_ptr);
+  REQUIRE(ptr_converted.UNSAFE_unverified() == expected_ptr_converted);
+
+  sandbox.free_in_sandbox(arr);
+  converted.free_in_sandbox(arr_converted);
+  converted.destroy_sandbox();
+  sandbox.destroy_sandbox();
+}
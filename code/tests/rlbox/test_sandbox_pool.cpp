@@ -0,0 +1,166 @@
+// NOLINTNEXTLINE
+#define RLBOX_USE_STATIC_CALLS() rlbox_noop_sandbox_lookup_symbol
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "test_include.hpp"
+
+#include "rlbox_sandbox_pool.hpp"
+
+using rlbox::rlbox_noop_sandbox;
+using RL = rlbox::rlbox_sandbox<rlbox_noop_sandbox>;
+using Pool = rlbox::rlbox_sandbox_pool<rlbox_noop_sandbox>;
+
+static int pool_test_add(int a, int b)
+{
+  return a + b;
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox pool checkout and return", "[sandbox pool]")
+{
+  int created = 0;
+  int reset = 0;
+  bool reset_result = true;
+  const size_t count = 4;
+  const size_t shards = 2;
+
+  Pool pool(
+    count,
+    [&](RL& sandbox) {
+      created++;
+      return sandbox.create_sandbox();
+    },
+    [&](RL&) {
+      reset++;
+      return reset_result;
+    },
+    shards);
+
+  REQUIRE(created == count);
+  REQUIRE(pool.size() == count);
+  REQUIRE(pool.get_shard_count() == shards);
+
+  {
+    std::vector<Pool::handle> handles;
+    std::set<RL*> seen;
+    for (size_t i = 0; i < count; i++) {
+      handles.emplace_back(pool.checkout());
+      REQUIRE(handles.back());
+      seen.insert(handles.back().get());
+    }
+    REQUIRE(seen.size() == count);
+    REQUIRE(created == count);
+
+    // Exhausting the pool creates a new sandbox
+    auto extra = pool.checkout();
+    REQUIRE(created == count + 1);
+    REQUIRE(pool.size() == count + 1);
+
+    auto result = extra->invoke_sandbox_function(pool_test_add, 2, 3);
+    REQUIRE(result.UNSAFE_unverified() == 5);
+  }
+  REQUIRE(reset == count + 1);
+
+  // Returned sandboxes are reused
+  {
+    auto h = pool.checkout();
+    REQUIRE(created == count + 1);
+
+    // Moving a handle doesn't return the sandbox
+    auto moved = std::move(h);
+    REQUIRE(!h);
+    REQUIRE(moved);
+    REQUIRE(reset == count + 1);
+
+    moved.release();
+    REQUIRE(!moved);
+    REQUIRE(reset == count + 2);
+  }
+
+  // A failed reset replaces the sandbox
+  reset_result = false;
+  {
+    auto h = pool.checkout();
+  }
+  REQUIRE(created == count + 2);
+  REQUIRE(pool.size() == count + 1);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox pool skips sandboxes that fail to create", "[sandbox pool]")
+{
+  const size_t count = 4;
+  int attempts = 0;
+  bool fail_create = false;
+  bool reset_result = true;
+
+  // Every other sandbox fails to create
+  Pool pool(
+    count,
+    [&](RL& sandbox) {
+      attempts++;
+      if (fail_create || attempts % 2 == 0) {
+        return false;
+      }
+      return sandbox.create_sandbox();
+    },
+    [&](RL&) { return reset_result; },
+    2);
+
+  REQUIRE(attempts == count);
+  REQUIRE(pool.size() == count / 2);
+
+  {
+    std::vector<Pool::handle> handles;
+    for (size_t i = 0; i < count / 2; i++) {
+      handles.emplace_back(pool.checkout());
+      REQUIRE(handles.back());
+    }
+
+    // Growing the pool fails, so the handle is empty
+    fail_create = true;
+    auto extra = pool.checkout();
+    REQUIRE(!extra);
+    REQUIRE(pool.size() == count / 2);
+
+    // A sandbox that fails to be replaced is dropped from the pool
+    reset_result = false;
+    handles.pop_back();
+    REQUIRE(pool.size() == count / 2 - 1);
+  }
+
+  // The pool destroys only the sandboxes that were created
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox pool concurrent checkout", "[sandbox pool]")
+{
+  const size_t count = 8;
+  Pool pool(count, [](RL& sandbox) { return sandbox.create_sandbox(); });
+
+  const int thread_count = 4;
+  const int iterations = 1000;
+  std::atomic<int> mismatches{ 0 };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < iterations; i++) {
+        auto h = pool.checkout();
+        auto result = h->invoke_sandbox_function(pool_test_add, i, 1);
+        if (result.UNSAFE_unverified() != i + 1) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(mismatches.load() == 0);
+  REQUIRE(pool.size() == count);
+}
@@ -0,0 +1,105 @@
+// NOLINTNEXTLINE
+#define RLBOX_USE_STATIC_CALLS() rlbox_noop_sandbox_lookup_symbol
+
+#include <cstdint>
+#include <set>
+
+#include "test_include.hpp"
+
+#include "rlbox_sandbox_slab.hpp"
+
+using rlbox::rlbox_noop_sandbox;
+using RL = rlbox::rlbox_sandbox<rlbox_noop_sandbox>;
+using Slab = rlbox::sandbox_slab_allocator<rlbox_noop_sandbox>;
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox slab allocation", "[sandbox slab]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+
+  {
+    const uint32_t chunk_size = 1024;
+    Slab slab(sandbox, chunk_size);
+
+    // Small objects of a size class come from the same chunk and are aligned
+    // to their size
+    auto p1 = slab.malloc_in_sandbox<uint64_t>();
+    auto p2 = slab.malloc_in_sandbox<char>(3);
+    auto p3 = slab.malloc_in_sandbox<uint64_t>(2);
+    REQUIRE(p1 != nullptr);
+    REQUIRE(p2 != nullptr);
+    REQUIRE(p3 != nullptr);
+    auto a1 = reinterpret_cast<uintptr_t>(p1.UNSAFE_unverified());
+    auto a2 = reinterpret_cast<uintptr_t>(p2.UNSAFE_unverified());
+    auto a3 = reinterpret_cast<uintptr_t>(p3.UNSAFE_unverified());
+    REQUIRE(a1 % alignof(uint64_t) == 0);
+    REQUIRE(a3 % 16 == 0);
+    REQUIRE(a2 == a1 + sizeof(uint64_t));
+    REQUIRE((a3 < a1 || a3 >= a1 + chunk_size));
+
+    *p3 = 1;
+    p3[1] = 2;
+    REQUIRE(p3[1].UNSAFE_unverified() == 2);
+
+    // Freed objects are reused by allocations of the same size class
+    slab.free_in_sandbox(p1);
+    auto p4 = slab.malloc_in_sandbox<uint32_t>(2);
+    REQUIRE(p4.UNSAFE_unverified() ==
+            reinterpret_cast<uint32_t*>(p1.UNSAFE_unverified()));
+
+    // Objects are distinct until freed
+    std::set<uintptr_t> seen;
+    for (int i = 0; i < 200; i++) { // NOLINT
+      auto p = slab.malloc_in_sandbox<uint64_t>(4);
+      REQUIRE(p != nullptr);
+      REQUIRE(seen.insert(reinterpret_cast<uintptr_t>(p.UNSAFE_unverified()))
+                .second);
+    }
+
+    // Large objects are passed through to the sandbox
+    auto large = slab.malloc_in_sandbox<char>(4 * chunk_size);
+    REQUIRE(large != nullptr);
+    slab.free_in_sandbox(large, 4 * chunk_size);
+
+    slab.free_in_sandbox(p2, 3);
+    slab.free_in_sandbox(p3, 2);
+    slab.free_in_sandbox(p4, 2);
+  }
+
+  {
+    Slab slab(sandbox);
+    auto p1 = slab.malloc_in_sandbox<uint64_t>(2);
+    auto p2 = slab.malloc_in_sandbox<uint64_t>(2);
+    REQUIRE(p1 != nullptr);
+    REQUIRE(p2 != nullptr);
+
+    // Only the start of a block of the freed size class can be freed
+    REQUIRE_THROWS(slab.free_in_sandbox(p1, 1));
+    REQUIRE_THROWS(slab.free_in_sandbox(p1 + 1, 1));
+    // The block after p2 has not been handed out yet
+    REQUIRE_THROWS(slab.free_in_sandbox(p2 + 2, 2));
+    auto other = sandbox.malloc_in_sandbox<uint64_t>(2);
+    REQUIRE_THROWS(slab.free_in_sandbox(other, 2));
+    sandbox.free_in_sandbox(other);
+
+    slab.free_in_sandbox(p1, 2);
+    REQUIRE_THROWS(slab.free_in_sandbox(p1, 2));
+    slab.free_in_sandbox(p2, 2);
+  }
+
+  REQUIRE_THROWS(Slab(sandbox, 16));
+
+  sandbox.destroy_sandbox();
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox slab after sandbox destruction", "[sandbox slab]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+  sandbox.destroy_sandbox();
+
+  Slab slab(sandbox);
+  REQUIRE(slab.malloc_in_sandbox<int>() == nullptr);
+}
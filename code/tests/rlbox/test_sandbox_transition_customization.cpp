@@ -69,5 +69,14 @@ TEST_CASE("sandbox transition customization",
   REQUIRE(transition_in_count == 1);
   REQUIRE(transition_out_count == 1);
 
+  // A batch of calls is a single transition
+  auto results =
+    sandbox.invoke_sandbox_batch(sandbox.bind_sandbox_function(add, val1, val2),
+                                 sandbox.bind_sandbox_function(add, val2, val2));
+  REQUIRE(transition_in_count == 2);
+  REQUIRE(transition_out_count == 2);
+  REQUIRE(std::get<0>(results).UNSAFE_unverified() == val1 + val2);
+  REQUIRE(std::get<1>(results).UNSAFE_unverified() == val2 + val2);
+
   sandbox.destroy_sandbox();
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+// NOLINTNEXTLINE
+#define RLBOX_USE_STATIC_CALLS() rlbox_noop_sandbox_lookup_symbol
+#define RLBOX_USE_EXCEPTIONS
+#define RLBOX_ENABLE_DEBUG_ASSERTIONS
+#define RLBOX_MEASURE_TRANSITION_TIMES
+#define RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS 8
+#include "rlbox_noop_sandbox.hpp"
+#include "test_include.hpp"
+
+#include <cstring>
+#include <vector>
+
+using rlbox::rlbox_noop_sandbox;
+using rlbox::tainted;
+using RL = rlbox::rlbox_sandbox<rlbox_noop_sandbox>;
+
+static int add(int a, int b)
+{
+  return a + b;
+}
+
+static int sub(int a, int b)
+{
+  return a - b;
+}
+
+using T_Func_int_int = int (*)(int);
+
+static tainted<int, rlbox_noop_sandbox> increment(
+  RL&, // NOLINT
+  tainted<int, rlbox_noop_sandbox> val)
+{
+  return val + 1;
+}
+
+static int call_twice(T_Func_int_int cb, int val)
+{
+  return cb(cb(val));
+}
+
+static const rlbox::rlbox_transition_latency_stats* find_stats(
+  const std::vector<rlbox::rlbox_transition_latency_stats>& stats,
+  rlbox::rlbox_transition invoke,
+  const char* name)
+{
+  for (auto& stat : stats) {
+    if (stat.invoke == invoke &&
+        (name == nullptr || std::strcmp(stat.name, name) == 0)) {
+      return &stat;
+    }
+  }
+  return nullptr;
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("transition latency histogram buckets", "[sandbox_timing_tests]")
+{
+  using H = rlbox::detail::transition_latency_histogram;
+
+  uint32_t prev_index = 0;
+  for (uint64_t val = 0; val < 100000; val++) {
+    auto index = H::get_bucket_index(val);
+    REQUIRE(index >= prev_index);
+    REQUIRE(val <= H::get_bucket_upper_bound(index));
+    // Bucket width stays within 12.5% of the values in the bucket
+    REQUIRE(H::get_bucket_upper_bound(index) - val <= val / 8);
+    prev_index = index;
+  }
+  REQUIRE(H::get_bucket_index(UINT64_MAX) == H::bucket_count - 1);
+
+  H histogram;
+  const int64_t fast = 100;
+  const int64_t slow = 10000;
+  for (int i = 0; i < 98; i++) {
+    histogram.record(fast, 1);
+  }
+  histogram.record(slow, 2);
+  REQUIRE(histogram.get_count() == 100);
+  REQUIRE(histogram.get_max() == slow);
+  REQUIRE(histogram.get_percentile(50) >= fast);
+  REQUIRE(histogram.get_percentile(50) <= fast + fast / 8);
+  REQUIRE(histogram.get_percentile(99) == slow);
+
+  rlbox::detail::transition_latency_table<2> table;
+  int keys[3];
+  for (auto& key : keys) {
+    table.record(&key, "key", fast, 1);
+  }
+  REQUIRE(table.get_untracked() == 1);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox timing histogram tests", "[sandbox_timing_tests]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+
+  const int add_iterations = 10;
+  const int sub_iterations = 3;
+  for (int i = 0; i < add_iterations; i++) {
+    sandbox.invoke_sandbox_function(add, 2, 3);
+  }
+  for (int i = 0; i < sub_iterations; i++) {
+    sandbox.invoke_sandbox_function(sub, 2, 3);
+  }
+
+  auto cb = sandbox.register_callback(increment);
+  auto ret = sandbox.invoke_sandbox_function(call_twice, cb, 1)
+               .unverified_safe_because("test");
+  REQUIRE(ret == 3);
+
+  auto stats = sandbox.get_transition_latency_stats();
+  REQUIRE(stats.size() == 4);
+
+  auto add_stats = find_stats(stats, rlbox::rlbox_transition::INVOKE, "add");
+  REQUIRE(add_stats != nullptr);
+  REQUIRE(add_stats->count == add_iterations);
+  REQUIRE(add_stats->p50 <= add_stats->p99);
+  REQUIRE(add_stats->p99 <= add_stats->max);
+
+  auto sub_stats = find_stats(stats, rlbox::rlbox_transition::INVOKE, "sub");
+  REQUIRE(sub_stats != nullptr);
+  REQUIRE(sub_stats->count == sub_iterations);
+
+  auto cb_stats = find_stats(stats, rlbox::rlbox_transition::CALLBACK, nullptr);
+  REQUIRE(cb_stats != nullptr);
+  REQUIRE(cb_stats->count == 2);
+  REQUIRE(sandbox.get_untracked_transition_latency_count() == 0);
+
+  // Only the histograms and the total time are kept
+  REQUIRE(sandbox.process_and_get_transition_times().empty());
+  REQUIRE(sandbox.get_total_ns_time_in_sandbox_and_transitions() != 0);
+
+  sandbox.clear_transition_times();
+  REQUIRE(sandbox.get_transition_latency_stats().empty());
+  REQUIRE(sandbox.get_total_ns_time_in_sandbox_and_transitions() == 0);
+
+  cb.unregister();
+  sandbox.destroy_sandbox();
+}
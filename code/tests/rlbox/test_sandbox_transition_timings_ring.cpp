@@ -0,0 +1,128 @@
+// NOLINTNEXTLINE
+#define RLBOX_USE_STATIC_CALLS() rlbox_noop_sandbox_lookup_symbol
+#define RLBOX_USE_EXCEPTIONS
+#define RLBOX_ENABLE_DEBUG_ASSERTIONS
+#define RLBOX_MEASURE_TRANSITION_TIMES
+#define RLBOX_TRANSITION_TIMES_RING_SIZE 16
+#define RLBOX_TRANSITION_TIMES_MAX_RECORDS 64
+#include "rlbox_noop_sandbox.hpp"
+#include "test_include.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using RL = rlbox::rlbox_sandbox<rlbox::rlbox_noop_sandbox>;
+
+static int add(int a, int b)
+{
+  return a + b;
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox timing ring tests", "[sandbox_timing_tests]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+
+  SECTION("Records from multiple threads are merged") // NOLINT
+  {
+    const int iterations = 10;
+    const int thread_count = 4;
+    std::atomic<int> mismatches{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+      threads.emplace_back([&] {
+        for (int i = 0; i < iterations; i++) {
+          auto result = sandbox.invoke_sandbox_function(add, 2, 3)
+                          .unverified_safe_because("test");
+          if (result != 5) {
+            mismatches++;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    REQUIRE(mismatches.load() == 0);
+    auto& transition_times = sandbox.process_and_get_transition_times();
+    REQUIRE(transition_times.size() == iterations * thread_count);
+    REQUIRE(sandbox.get_dropped_transition_times_count() == 0);
+    REQUIRE(sandbox.get_total_ns_time_in_sandbox_and_transitions() > 0);
+  }
+
+  SECTION("Full rings drop and count records") // NOLINT
+  {
+    const int iterations = 20;
+    for (int i = 0; i < iterations; i++) {
+      sandbox.invoke_sandbox_function(add, 2, 3);
+    }
+    REQUIRE(sandbox.get_dropped_transition_times_count() == iterations - 16);
+    REQUIRE(sandbox.process_and_get_transition_times().size() == 16);
+
+    // Merging frees up the ring again
+    sandbox.invoke_sandbox_function(add, 2, 3);
+    REQUIRE(sandbox.process_and_get_transition_times().size() == 17);
+
+    sandbox.clear_transition_times();
+    REQUIRE(sandbox.get_dropped_transition_times_count() == 0);
+    REQUIRE(sandbox.process_and_get_transition_times().empty());
+  }
+
+  SECTION("Merged records are bounded") // NOLINT
+  {
+    const int merges = 5;
+    for (int m = 0; m < merges; m++) {
+      for (int i = 0; i < 16; i++) {
+        sandbox.invoke_sandbox_function(add, 2, 3);
+      }
+      sandbox.process_and_get_transition_times();
+    }
+
+    auto& transition_times = sandbox.process_and_get_transition_times();
+    REQUIRE(transition_times.size() == 64);
+    REQUIRE(sandbox.get_dropped_transition_times_count() == 16);
+
+    // Dropped records still count towards the total time
+    int64_t kept_total = 0;
+    for (auto& transition_time : transition_times) {
+      kept_total += transition_time.time;
+    }
+    REQUIRE(sandbox.get_total_ns_time_in_sandbox_and_transitions() >=
+            kept_total);
+  }
+
+  SECTION("Rings of exited threads are merged and freed") // NOLINT
+  {
+    const int thread_count = 8;
+    for (int t = 0; t < thread_count; t++) {
+      std::thread thread([&] { sandbox.invoke_sandbox_function(add, 2, 3); });
+      thread.join();
+      REQUIRE(sandbox.process_and_get_transition_times().size() ==
+              static_cast<size_t>(t + 1));
+    }
+    REQUIRE(sandbox.get_dropped_transition_times_count() == 0);
+  }
+
+  SECTION("A thread alternating between sandboxes records into both") // NOLINT
+  {
+    RL other;
+    other.create_sandbox();
+
+    const int iterations = 8;
+    for (int i = 0; i < iterations; i++) {
+      sandbox.invoke_sandbox_function(add, 2, 3);
+      other.invoke_sandbox_function(add, 2, 3);
+    }
+    REQUIRE(sandbox.process_and_get_transition_times().size() == iterations);
+    REQUIRE(other.process_and_get_transition_times().size() == iterations);
+
+    // The thread's ring for the destroyed sandbox is released when it next
+    // needs a new ring
+    other.destroy_sandbox();
+  }
+
+  sandbox.destroy_sandbox();
+}
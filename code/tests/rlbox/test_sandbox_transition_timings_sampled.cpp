@@ -0,0 +1,109 @@
+// NOLINTNEXTLINE
+#define RLBOX_USE_STATIC_CALLS() rlbox_noop_sandbox_lookup_symbol
+#define RLBOX_USE_EXCEPTIONS
+#define RLBOX_ENABLE_DEBUG_ASSERTIONS
+#define RLBOX_MEASURE_TRANSITION_TIMES
+#define RLBOX_TRANSITION_TIMES_SAMPLE_RATE 4
+#define RLBOX_TRANSITION_TIMES_HISTOGRAM_SLOTS 8
+#define RLBOX_TRANSITION_TIMES_KEEP_RECORDS
+#include "rlbox_noop_sandbox.hpp"
+#include "test_include.hpp"
+
+#include <thread>
+
+using rlbox::rlbox_noop_sandbox;
+using rlbox::tainted;
+using RL = rlbox::rlbox_sandbox<rlbox_noop_sandbox>;
+
+static int add(int a, int b)
+{
+  return a + b;
+}
+
+using T_Func_int_int = int (*)(int);
+
+static tainted<int, rlbox_noop_sandbox> increment(
+  RL&, // NOLINT
+  tainted<int, rlbox_noop_sandbox> val)
+{
+  return val + 1;
+}
+
+static int call_thrice(T_Func_int_int cb, int val)
+{
+  return cb(cb(cb(val)));
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox sampled timing tests", "[sandbox_timing_tests]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+
+  const int sample_rate = 4;
+  const int iterations = 8;
+
+  // Run on a fresh thread so the thread's sampling countdown starts at 0
+  std::thread t([&] {
+    for (int i = 0; i < iterations; i++) {
+      sandbox.invoke_sandbox_function(add, 2, 3);
+    }
+  });
+  t.join();
+
+  auto& transition_times = sandbox.process_and_get_transition_times();
+  REQUIRE(transition_times.size() == iterations / sample_rate);
+
+  int64_t sampled_total = 0;
+  for (auto& transition_time : transition_times) {
+    sampled_total += transition_time.time;
+  }
+  REQUIRE(sandbox.get_total_ns_time_in_sandbox_and_transitions() ==
+          sampled_total * sample_rate);
+
+  auto stats = sandbox.get_transition_latency_stats();
+  REQUIRE(stats.size() == 1);
+  REQUIRE(stats[0].count == iterations);
+
+  sandbox.destroy_sandbox();
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox sampled timing per transition kind",
+          "[sandbox_timing_tests]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+
+  const int sample_rate = 4;
+  const int iterations = 8;
+  const int callbacks_per_invoke = 3;
+
+  auto cb = sandbox.register_callback(increment);
+
+  // Each iteration is 1 invoke and 3 callbacks, which is a multiple of the
+  // sample rate. Invokes and callbacks should still both be sampled.
+  std::thread t([&] {
+    for (int i = 0; i < iterations; i++) {
+      auto ret = sandbox.invoke_sandbox_function(call_thrice, cb, 1)
+                   .unverified_safe_because("test");
+      REQUIRE(ret == 4);
+    }
+  });
+  t.join();
+
+  size_t invoke_count = 0;
+  size_t callback_count = 0;
+  for (auto& transition_time : sandbox.process_and_get_transition_times()) {
+    if (transition_time.invoke == rlbox::rlbox_transition::INVOKE) {
+      invoke_count++;
+    } else {
+      callback_count++;
+    }
+  }
+  REQUIRE(invoke_count == iterations / sample_rate);
+  REQUIRE(callback_count == iterations * callbacks_per_invoke / sample_rate);
+
+  cb.unregister();
+  sandbox.destroy_sandbox();
+}
@@ -0,0 +1,62 @@
+// NOLINTNEXTLINE
+#define RLBOX_USE_STATIC_CALLS() rlbox_noop_sandbox_lookup_symbol
+#define RLBOX_USE_EXCEPTIONS
+#define RLBOX_ENABLE_DEBUG_ASSERTIONS
+#define RLBOX_MEASURE_TRANSITION_TIMES
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||           \
+  defined(_M_IX86)
+#  define RLBOX_TRANSITION_TIMES_CLOCK rlbox::rlbox_transition_tsc_clock
+#endif
+#include "rlbox_noop_sandbox.hpp"
+#include "test_include.hpp"
+
+#include <chrono>
+#include <thread>
+
+using RL = rlbox::rlbox_sandbox<rlbox::rlbox_noop_sandbox>;
+
+static int add(int a, int b)
+{
+  return a + b;
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox timing clock tests", "[sandbox_timing_tests]")
+{
+  RL sandbox;
+  sandbox.create_sandbox();
+
+  SECTION("Clock measures elapsed time") // NOLINT
+  {
+    using T_Clock = RLBOX_TRANSITION_TIMES_CLOCK;
+    const int64_t sleep_ns = 5 * 1000 * 1000;
+    auto start = T_Clock::now();
+    std::this_thread::sleep_for(std::chrono::nanoseconds(sleep_ns));
+    auto ns = T_Clock::to_ns(T_Clock::now() - start);
+    REQUIRE(ns >= sleep_ns * 9 / 10);
+    REQUIRE(ns < sleep_ns * 100);
+
+    auto overhead =
+      rlbox::detail::get_transition_clock_overhead_ns<T_Clock>();
+    REQUIRE(overhead >= 0);
+    REQUIRE(overhead < sleep_ns);
+  }
+
+  SECTION("Per function test") // NOLINT
+  {
+    const int iterations = 10;
+    for (int i = 0; i < iterations; i++) {
+      auto result = sandbox.invoke_sandbox_function(add, 2, 3)
+                      .unverified_safe_because("test");
+      REQUIRE(result == 5);
+    }
+
+    auto& transition_times = sandbox.process_and_get_transition_times();
+    REQUIRE(transition_times.size() == iterations);
+    for (auto& transition_time : transition_times) {
+      REQUIRE(transition_time.time >= 0);
+    }
+  }
+
+  sandbox.destroy_sandbox();
+}
@@ -0,0 +1,84 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_include.hpp"
+
+using rlbox::detail::symbol_cache;
+
+static void* get_value(int i)
+{
+  return reinterpret_cast<void*>(static_cast<uintptr_t>(i + 1) * 16);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test symbol cache lookups", "[symbol cache]")
+{
+  symbol_cache cache;
+  void* value = nullptr;
+  REQUIRE(!cache.find("foo", value));
+
+  cache.insert("foo", get_value(0));
+  REQUIRE(cache.find("foo", value));
+  REQUIRE(value == get_value(0));
+
+  // Lookups match on contents, not on pointer identity
+  std::string name = "foo";
+  REQUIRE(cache.find(name.c_str(), value));
+  REQUIRE(value == get_value(0));
+  REQUIRE(!cache.find("fo", value));
+  REQUIRE(!cache.find("fooo", value));
+
+  // The first insert wins
+  cache.insert(name, get_value(1));
+  REQUIRE(cache.find("foo", value));
+  REQUIRE(value == get_value(0));
+
+  // Force the table to grow a few times
+  const int count = 1000;
+  for (int i = 0; i < count; i++) {
+    cache.insert("sym" + std::to_string(i), get_value(i));
+  }
+  for (int i = 0; i < count; i++) {
+    REQUIRE(cache.find("sym" + std::to_string(i), value));
+    REQUIRE(value == get_value(i));
+  }
+  REQUIRE(cache.find("foo", value));
+  REQUIRE(value == get_value(0));
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test symbol cache concurrent access", "[symbol cache]")
+{
+  symbol_cache cache;
+  const int thread_count = 4;
+  const int count = 500;
+  std::atomic<int> mismatches{ 0 };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < count; i++) {
+        auto name = "sym" + std::to_string(i);
+        void* value = nullptr;
+        if (!cache.find(name, value)) {
+          cache.insert(name, get_value(i));
+          if (!cache.find(name, value)) {
+            mismatches++;
+            continue;
+          }
+        }
+        if (value != get_value(i)) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(mismatches.load() == 0);
+}
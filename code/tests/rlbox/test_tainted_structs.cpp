@@ -114,4 +114,47 @@ TEST_CASE("Tainted full struct assignment", "[tainted_struct]")
   sandbox.free_in_sandbox(p);
 
   sandbox.destroy_sandbox();
-}
\ No newline at end of file
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Tainted structs with matching layouts are copied whole",
+          "[tainted_struct]")
+{
+  using rlbox::rlbox_noop_sandbox;
+
+  REQUIRE(
+    rlbox::detail::struct_layout_matches<testPlainStruct,
+                                         rlbox_noop_sandbox>::value);
+  // TestSandbox uses 32-bit pointers, so pointer fields must be swizzled
+  REQUIRE_FALSE(
+    rlbox::detail::struct_layout_matches<testPlainStruct, TestSandbox>::value);
+  // Function pointer fields are always converted field by field
+  REQUIRE_FALSE(
+    rlbox::detail::struct_layout_matches<testVarietyStruct,
+                                         rlbox_noop_sandbox>::value);
+
+  rlbox::rlbox_sandbox<rlbox_noop_sandbox> sandbox;
+  sandbox.create_sandbox();
+
+  const auto fieldLong = 7;
+  const auto fieldBool = 1;
+  auto fieldString = sandbox.malloc_in_sandbox<char>();
+
+  tainted<testPlainStruct, rlbox_noop_sandbox> s{};
+  s.fieldLong = fieldLong;
+  s.fieldString = sandbox_reinterpret_cast<const char*>(fieldString);
+  s.fieldBool = fieldBool;
+
+  auto p = sandbox.malloc_in_sandbox<testPlainStruct>();
+  *p = s;
+  tainted<testPlainStruct, rlbox_noop_sandbox> copy = *p;
+  REQUIRE(copy.fieldLong.UNSAFE_unverified() == fieldLong);
+  REQUIRE(copy.fieldString.UNSAFE_unverified() ==
+          fieldString.UNSAFE_unverified());
+  REQUIRE(copy.fieldBool.UNSAFE_unverified() == fieldBool);
+  REQUIRE(copy.voidPtr.UNSAFE_unverified() == nullptr);
+
+  sandbox.free_in_sandbox(p);
+  sandbox.free_in_sandbox(fieldString);
+  sandbox.destroy_sandbox();
+}
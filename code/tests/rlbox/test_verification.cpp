@@ -59,6 +59,14 @@ TEST_CASE("RLBox test pointer verification", "[verification]")
   auto result2 = pa.copy_and_verify_address([](uintptr_t val) { return val; });
   REQUIRE(pa.UNSAFE_unverified() == reinterpret_cast<int*>(result2)); // NOLINT
 
+  // long is smaller in the sandbox, so the value must be converted
+  tainted<long*, TestSandbox> pl = sandbox.malloc_in_sandbox<long>(2); // NOLINT
+  pl[0] = -testVal;
+  pl[1] = 0;
+  auto result3 = pl.copy_and_verify(
+    [](std::unique_ptr<long> val) { return *val; }); // NOLINT
+  REQUIRE(result3 == -testVal);
+
   sandbox.destroy_sandbox();
 }
 
@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test_include.hpp"
+#include "test_tainted_structs.hpp"
+
+using rlbox::verify_arena;
+
+// NOLINTNEXTLINE
+TEST_CASE("Test verify arena allocation", "[verify arena]")
+{
+  const size_t chunk_size = 256;
+  verify_arena arena(chunk_size);
+  REQUIRE(arena.capacity() == 0);
+
+  auto p1 = static_cast<char*>(arena.allocate(3, 1));
+  auto p2 = arena.allocate_array<uint64_t>(2);
+  REQUIRE(reinterpret_cast<uintptr_t>(p2) % alignof(uint64_t) == 0);
+  REQUIRE(reinterpret_cast<char*>(p2) >= p1 + 3);
+  REQUIRE(arena.capacity() == chunk_size);
+
+  // Fills the rest of the chunk, so a second chunk is needed
+  arena.allocate(chunk_size / 2, 1);
+  arena.allocate(chunk_size / 2, 1);
+  REQUIRE(arena.capacity() == 2 * chunk_size);
+
+  // Large allocations don't use chunks
+  auto large = static_cast<char*>(arena.allocate(4 * chunk_size, 64));
+  REQUIRE(reinterpret_cast<uintptr_t>(large) % 64 == 0);
+  std::memset(large, 0, 4 * chunk_size);
+  REQUIRE(arena.capacity() == 2 * chunk_size);
+
+  // Chunks are reused after a reset
+  arena.reset();
+  REQUIRE(static_cast<char*>(arena.allocate(3, 1)) == p1);
+  arena.allocate(chunk_size / 2, 1);
+  arena.allocate(chunk_size / 2, 1);
+  REQUIRE(arena.capacity() == 2 * chunk_size);
+
+  arena.release();
+  REQUIRE(arena.capacity() == 0);
+
+  REQUIRE_THROWS(arena.allocate(1, 3));
+  REQUIRE_THROWS(arena.allocate_array<uint64_t>(SIZE_MAX / 4));
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test verify arena allocator", "[verify arena]")
+{
+  verify_arena arena;
+  {
+    std::vector<int, verify_arena::allocator<int>> vec(arena);
+    for (int i = 0; i < 100; i++) { // NOLINT
+      vec.push_back(i);
+    }
+    REQUIRE(vec[99] == 99); // NOLINT
+  }
+  REQUIRE(arena.capacity() == verify_arena::default_chunk_size);
+
+  verify_arena::allocator<char> a1(arena);
+  verify_arena::allocator<long> a2(a1); // NOLINT
+  verify_arena other;
+  REQUIRE(a1 == a2);
+  REQUIRE(a1 != verify_arena::allocator<char>(other));
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("Test copy and verify into verify arena", "[verify arena]")
+{
+  rlbox::rlbox_sandbox<TestSandbox> sandbox;
+  sandbox.create_sandbox();
+  verify_arena arena;
+
+  const size_t count = 40;
+  auto pa = sandbox.malloc_in_sandbox<long>(count); // NOLINT
+  for (size_t i = 0; i < count; i++) {
+    pa[i] = -static_cast<long>(i); // NOLINT
+  }
+
+  const char* str = "A string too long for small string buffers";
+  const size_t str_len = std::strlen(str);
+  auto pc = sandbox.malloc_in_sandbox<char>(str_len + 1);
+  std::strncpy(pc.UNSAFE_unverified(), str, str_len + 1);
+
+  const unsigned long testVal = 7;
+  auto ps = sandbox.malloc_in_sandbox<testVarietyStruct>();
+  *ps = rlbox::tainted<testVarietyStruct, TestSandbox>{};
+  ps->fieldLong = testVal;
+
+  {
+    rlbox::tainted<long*, TestSandbox> pnull = nullptr; // NOLINT
+    REQUIRE(pnull.copy_and_verify([](long* val) { return val; }, arena) ==
+            nullptr);
+    REQUIRE(pnull.copy_and_verify_range(
+              [](long* val) { return val; }, count, arena) == nullptr);
+    rlbox::tainted<char*, TestSandbox> cnull = nullptr;
+    REQUIRE(cnull.copy_and_verify_string([](char* val) { return val; },
+                                         arena) == nullptr);
+    rlbox::tainted<testVarietyStruct*, TestSandbox> snull = nullptr;
+    REQUIRE(snull.copy_and_verify(
+              [](rlbox::tainted<testVarietyStruct, TestSandbox>* val) {
+                return val;
+              },
+              arena) == nullptr);
+  }
+
+  auto el = (pa + 1).copy_and_verify([](long* val) { return val; }, arena);
+  REQUIRE(*el == -1);
+
+  auto range =
+    pa.copy_and_verify_range([](long* val) { return val; }, count, arena);
+  for (size_t i = 0; i < count; i++) {
+    REQUIRE(range[i] == -static_cast<long>(i)); // NOLINT
+  }
+
+  auto copy =
+    pc.copy_and_verify_string([](char* val) { return val; }, arena);
+  REQUIRE(std::string(copy) == str);
+
+  auto fieldLong = ps.copy_and_verify(
+    [](rlbox::tainted<testVarietyStruct, TestSandbox>* val) {
+      return val->fieldLong.UNSAFE_unverified();
+    },
+    arena);
+  REQUIRE(fieldLong == testVal);
+
+  // The copies are not affected by later writes to sandbox memory
+  pa[0] = 1;
+  pc[0] = 'a';
+  REQUIRE(range[0] == 0);
+  REQUIRE(copy[0] == 'A');
+
+  // All copies live in the arena
+  REQUIRE(arena.capacity() == verify_arena::default_chunk_size);
+  arena.reset();
+  REQUIRE(pa.copy_and_verify_range(
+            [](long* val) { return val; }, count, arena) == el);
+
+  sandbox.free_in_sandbox(ps);
+  sandbox.free_in_sandbox(pc);
+  sandbox.free_in_sandbox(pa);
+  sandbox.destroy_sandbox();
+}
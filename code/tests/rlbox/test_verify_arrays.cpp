@@ -2,6 +2,8 @@
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "test_include.hpp"
 
@@ -81,6 +83,34 @@ TEST_CASE("RLBox test range verification", "[verification]")
   sandbox.destroy_sandbox();
 }
 
+// NOLINTNEXTLINE
+TEST_CASE("RLBox test range verification of differently sized types",
+          "[verification]")
+{
+  rlbox::rlbox_sandbox<TestSandbox> sandbox;
+  sandbox.create_sandbox();
+
+  // long is 32 bits in the TestSandbox, so each element has to be widened
+  const uint32_t count = 64;
+  auto pa = sandbox.malloc_in_sandbox<long>(count); // NOLINT
+  for (uint32_t i = 0; i < count; i++) {
+    pa[i] = -static_cast<long>(i); // NOLINT
+  }
+
+  auto checked_range = pa.copy_and_verify_range(
+    [](std::unique_ptr<long[]> val) { // NOLINT
+      return val;
+    },
+    count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    REQUIRE(checked_range[i] == -static_cast<long>(i)); // NOLINT
+  }
+
+  sandbox.free_in_sandbox(pa);
+  sandbox.destroy_sandbox();
+}
+
 // NOLINTNEXTLINE
 TEST_CASE("RLBox test string verification", "[verification]")
 {
@@ -113,4 +143,175 @@ TEST_CASE("RLBox test string verification", "[verification]")
   }
 
   sandbox.destroy_sandbox();
-}
\ No newline at end of file
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("RLBox test string verification stops at the end of the sandbox",
+          "[verification]")
+{
+  rlbox::rlbox_sandbox<TestSandbox> sandbox;
+  sandbox.create_sandbox();
+
+  auto pc = sandbox.malloc_in_sandbox<char>();
+  char* raw = pc.UNSAFE_unverified();
+  auto base = static_cast<char*>(sandbox.get_memory_location());
+  const size_t remaining =
+    rlbox::rlbox_sandbox<TestSandbox>::get_memory_remaining_no_ctx(raw);
+  REQUIRE(remaining == sandbox.get_total_memory() - (raw - base));
+  REQUIRE(sandbox.get_memory_remaining(raw) == remaining);
+
+  // Terminated on the last byte of sandbox memory
+  std::memset(raw, 'a', remaining - 1);
+  raw[remaining - 1] = '\0';
+  auto checked_string =
+    pc.copy_and_verify_string([](std::string val) { return val; });
+  REQUIRE(checked_string.size() == remaining - 1);
+  auto checked_string_ctx =
+    pc.copy_and_verify_string(sandbox, [](std::string val) { return val; });
+  REQUIRE(checked_string_ctx.size() == remaining - 1);
+
+  // Not terminated in sandbox memory
+  raw[remaining - 1] = 'a';
+  REQUIRE_THROWS(pc.copy_and_verify_string([](std::string val) { return val; }));
+  REQUIRE_THROWS(pc.copy_and_verify_string(
+    [](std::unique_ptr<char[]> val) { return val; })); // NOLINT
+  REQUIRE_THROWS(
+    pc.copy_and_verify_string(sandbox, [](std::string val) { return val; }));
+  rlbox::verify_arena arena;
+  REQUIRE_THROWS(pc.copy_and_verify_string(
+    sandbox, [](char* val) { return val; }, arena));
+
+  sandbox.destroy_sandbox();
+}
+
+template<typename T>
+struct CountingAllocator
+{
+  using value_type = T;
+
+  size_t* allocations;
+
+  explicit CountingAllocator(size_t* p_allocations)
+    : allocations(p_allocations)
+  {}
+
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U>& other) // NOLINT
+    : allocations(other.allocations)
+  {}
+
+  T* allocate(size_t n)
+  {
+    (*allocations)++;
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T* p, size_t n) { std::allocator<T>{}.deallocate(p, n); }
+
+  template<typename U>
+  bool operator==(const CountingAllocator<U>& other) const
+  {
+    return allocations == other.allocations;
+  }
+
+  template<typename U>
+  bool operator!=(const CountingAllocator<U>& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+// NOLINTNEXTLINE
+TEST_CASE("RLBox test verification into caller provided storage",
+          "[verification]")
+{
+  rlbox::rlbox_sandbox<TestSandbox> sandbox;
+  sandbox.create_sandbox();
+
+  const uint32_t count = 20;
+  auto pa = sandbox.malloc_in_sandbox<long>(count); // NOLINT
+  for (uint32_t i = 0; i < count; i++) {
+    pa[i] = -static_cast<long>(i); // NOLINT
+  }
+
+  const char* str = "A string too long for small string buffers";
+  const size_t str_len = std::strlen(str);
+  auto pc = sandbox.malloc_in_sandbox<char>(str_len + 1);
+  std::strncpy(pc.UNSAFE_unverified(), str, str_len + 1);
+
+  {
+    rlbox::tainted<long*, TestSandbox> pnull = nullptr; // NOLINT
+    long dest[count]{};                                  // NOLINT
+    REQUIRE(pnull.copy_and_verify_range_into(
+              [](long* val) { return val; }, &dest[0], count) == nullptr);
+    rlbox::tainted<char*, TestSandbox> cnull = nullptr;
+    char buffer[8]{}; // NOLINT
+    REQUIRE(cnull.copy_and_verify_string_into(
+              [](char* val) { return val; }, &buffer[0], sizeof(buffer)) ==
+            nullptr);
+  }
+
+  {
+    long dest[count]{}; // NOLINT
+    auto result = pa.copy_and_verify_range_into(
+      [](long* val) { return val; }, &dest[0], count); // NOLINT
+    REQUIRE(result == &dest[0]);
+    for (uint32_t i = 0; i < count; i++) {
+      REQUIRE(dest[i] == -static_cast<long>(i)); // NOLINT
+    }
+  }
+
+  {
+    char buffer[64]{}; // NOLINT
+    auto result = pc.copy_and_verify_string_into(
+      [](char* val) { return val; }, &buffer[0], sizeof(buffer));
+    REQUIRE(result == &buffer[0]);
+    REQUIRE(std::strcmp(&buffer[0], str) == 0);
+
+    // Exactly fits, including the terminator
+    result = pc.copy_and_verify_string_into(
+      [](char* val) { return val; }, &buffer[0], str_len + 1);
+    REQUIRE(result == &buffer[0]);
+
+    // Doesn't fit
+    result = pc.copy_and_verify_string_into(
+      [](char* val) { return val; }, &buffer[0], str_len);
+    REQUIRE(result == nullptr);
+
+    result = pc.copy_and_verify_string_into(
+      sandbox, [](char* val) { return val; }, &buffer[0], sizeof(buffer));
+    REQUIRE(result == &buffer[0]);
+    REQUIRE(std::strcmp(&buffer[0], str) == 0);
+  }
+
+  {
+    size_t allocations = 0;
+    CountingAllocator<char> alloc(&allocations);
+
+    auto range = pa.copy_and_verify_range(
+      [](std::vector<long, CountingAllocator<long>> val) { // NOLINT
+        return val;
+      },
+      count,
+      alloc);
+    REQUIRE(range.size() == count);
+    REQUIRE(range[count - 1] == -static_cast<long>(count - 1)); // NOLINT
+    REQUIRE(allocations == 1);
+
+    using T_String =
+      std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+    auto copy = pc.copy_and_verify_string(
+      [](T_String val) { return val; }, alloc);
+    REQUIRE(copy == str);
+    REQUIRE(allocations == 2);
+
+    auto copy_ctx = pc.copy_and_verify_string(
+      sandbox, [](T_String val) { return val; }, alloc);
+    REQUIRE(copy_ctx == str);
+    REQUIRE(allocations == 3);
+  }
+
+  sandbox.free_in_sandbox(pc);
+  sandbox.free_in_sandbox(pa);
+  sandbox.destroy_sandbox();
+}
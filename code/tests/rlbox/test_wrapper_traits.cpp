@@ -99,4 +99,16 @@ TEST_CASE("rlbox_remove_wrapper_t", "[wrapper_traits]")
   REQUIRE(std::is_same_v<
           rlbox_remove_wrapper_t<sandbox_callback<int (*)(int), TestSandbox>>,
           int (*)(int)>);
-}
\ No newline at end of file
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("is_abi_identical_v", "[wrapper_traits]")
+{
+  using rlbox::detail::is_abi_identical_v;
+
+  // The noop sandbox uses the application's types unchanged
+  REQUIRE(is_abi_identical_v<rlbox::rlbox_noop_sandbox>);
+
+  // The test sandbox has 32-bit pointers and longs
+  REQUIRE(!is_abi_identical_v<TestSandbox>);
+}
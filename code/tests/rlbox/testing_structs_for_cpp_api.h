@@ -24,8 +24,16 @@
   f(int (*[8])(unsigned, const char*, unsigned[1]),                            \
     fnArray, FIELD_NORMAL, ##__VA_ARGS__) g()
 
+#define sandbox_fields_reflection_testing_class_testPlainStruct(f, g, ...)     \
+  f(unsigned long, fieldLong, FIELD_NORMAL, ##__VA_ARGS__) g()                 \
+  f(const char*, fieldString, FIELD_NORMAL, ##__VA_ARGS__) g()                 \
+  f(unsigned int, fieldBool, FIELD_NORMAL, ##__VA_ARGS__) g()                  \
+  f(char[8], fieldFixedArr, FIELD_NORMAL, ##__VA_ARGS__) g()                   \
+  f(void*, voidPtr, FIELD_NORMAL, ##__VA_ARGS__) g()
+
 #define sandbox_fields_reflection_testing_allClasses(f, ...)                   \
-  f(testVarietyStruct, testing, ##__VA_ARGS__)
+  f(testVarietyStruct, testing, ##__VA_ARGS__)                                 \
+  f(testPlainStruct, testing, ##__VA_ARGS__)
 
 // clang-format on
 
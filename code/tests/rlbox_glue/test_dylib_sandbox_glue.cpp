@@ -22,3 +22,28 @@
 #endif
 
 #include "test_sandbox_glue.inc.cpp"
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox glue tests eager binding " TestName, "[sandbox_glue_tests]")
+{
+  rlbox::rlbox_sandbox<TestType> sandbox;
+  const bool bind_now = true;
+#if defined(_WIN32)
+  sandbox.create_sandbox(L"" GLUE_LIB_PATH, bind_now);
+#else
+  sandbox.create_sandbox(GLUE_LIB_PATH, bind_now);
+#endif
+  sandbox.prebind_sandbox_functions(simpleAddNoPrintTest);
+
+  const long val1 = 20;
+  const long val2 = 22;
+  auto ret = sandbox.invoke_sandbox_function(simpleAddNoPrintTest, val1, val2);
+  REQUIRE(ret.UNSAFE_unverified() == (val1 + val2));
+
+  // Cached symbols should not outlive the sandbox they were looked up in
+  sandbox.destroy_sandbox();
+  CreateSandbox(sandbox);
+  ret = sandbox.invoke_sandbox_function(simpleAddNoPrintTest, val1, val2);
+  REQUIRE(ret.UNSAFE_unverified() == (val1 + val2));
+  sandbox.destroy_sandbox();
+}
@@ -4,6 +4,7 @@
 #define RLBOX_ENABLE_DEBUG_ASSERTIONS
 #define RLBOX_SINGLE_THREADED_INVOCATIONS
 #define RLBOX_EMBEDDER_PROVIDES_TLS_STATIC_VARIABLES
+#define RLBOX_NOOP_SANDBOX_MAX_CALLBACKS 128
 #include "rlbox_noop_sandbox.hpp"
 
 // NOLINTNEXTLINE
@@ -15,4 +16,82 @@
 
 RLBOX_NOOP_SANDBOX_STATIC_VARIABLES();
 
-#include "test_sandbox_glue.inc.cpp"
\ No newline at end of file
+#include "test_sandbox_glue.inc.cpp"
+// A distinct function for each N, as a function can only be registered once
+template<unsigned long N> // NOLINT(google-runtime-int)
+static tainted<int, TestType> numberedCallback( // NOLINT(google-runtime-int)
+  rlbox_sandbox<TestType>& /* sandbox */,
+  tainted<unsigned long, TestType> val1, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val2 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val3 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val4 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val5 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val6 */) // NOLINT(google-runtime-int)
+{
+  return static_cast<int>(val1.UNSAFE_unverified() + N);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sandbox glue tests configured callback count " TestName,
+          "[sandbox_glue_tests]")
+{
+  rlbox::rlbox_sandbox<TestType> sandbox;
+  CreateSandbox(sandbox);
+
+  // More callbacks than the default limit of 64
+  constexpr size_t cb_count = 100;
+  using T_Cb = rlbox::sandbox_callback<
+    int (*)(unsigned long, // NOLINT(google-runtime-int)
+            unsigned long, // NOLINT(google-runtime-int)
+            unsigned long, // NOLINT(google-runtime-int)
+            unsigned long, // NOLINT(google-runtime-int)
+            unsigned long, // NOLINT(google-runtime-int)
+            unsigned long), // NOLINT(google-runtime-int)
+    TestType>;
+  std::vector<T_Cb> cbs(cb_count);
+  rlbox::detail::compile_time_for<cb_count>([&](auto I) {
+    cbs[I.value] = sandbox.register_callback(numberedCallback<I.value>);
+  });
+
+  auto check_callback = [&](size_t i) {
+    const unsigned long start = 4; // NOLINT(google-runtime-int)
+    auto resultT =
+      sandbox.invoke_sandbox_function(simpleCallbackTest2, start, cbs[i]);
+    auto result = resultT.copy_and_verify([](int val) { return val; });
+    REQUIRE(result == static_cast<int>(start + i));
+  };
+
+  for (size_t i = 0; i < cb_count; i++) {
+    REQUIRE(cbs[i].UNSAFE_sandboxed(sandbox) != nullptr);
+    check_callback(i);
+  }
+
+  // Freed slots are reused and the remaining callbacks are unaffected
+  for (size_t i = 0; i < cb_count; i += 2) {
+    cbs[i].unregister();
+  }
+  rlbox::detail::compile_time_for<cb_count>([&](auto I) {
+    if (I.value % 2 == 0) {
+      cbs[I.value] = sandbox.register_callback(numberedCallback<I.value>);
+    }
+  });
+  for (size_t i = 0; i < cb_count; i++) {
+    check_callback(i);
+  }
+
+  // Every slot is freed, so all callbacks can be registered again
+  for (auto& cb : cbs) {
+    cb.unregister();
+  }
+  rlbox::detail::compile_time_for<cb_count>([&](auto I) {
+    cbs[I.value] = sandbox.register_callback(numberedCallback<I.value>);
+  });
+  for (size_t i = 0; i < cb_count; i++) {
+    check_callback(i);
+  }
+
+  for (auto& cb : cbs) {
+    cb.unregister();
+  }
+  sandbox.destroy_sandbox();
+}
@@ -1,15 +1,23 @@
 #include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <variant>
+#include <vector>
 
 // IWYU pragma: no_forward_declare mpl_::na
 #include "catch2/catch.hpp"
 #include "libtest.h"
 #include "rlbox.hpp"
+#include "rlbox_sandbox_slab.hpp"
+#include "rlbox_sandbox_worker.hpp"
 
 #include "libtest_structs_for_cpp_api.h"
 rlbox_load_structs_from_library(libtest); // NOLINT
@@ -71,6 +79,26 @@ static tainted<int, TestType> exampleCallback(
   return ret; // NOLINT
 }
 
+static bool destroyFromAsyncFailed = false;
+
+static tainted<int, TestType> destroyingCallback( // NOLINT(google-runtime-int)
+  rlbox_sandbox<TestType>& sandbox,
+  tainted<unsigned long, TestType> /* val1 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val2 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val3 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val4 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val5 */, // NOLINT(google-runtime-int)
+  tainted<unsigned long, TestType> /* val6 */) // NOLINT(google-runtime-int)
+{
+  // The sandbox's worker can't wait for itself
+  try {
+    sandbox.destroy_sandbox();
+  } catch (...) {
+    destroyFromAsyncFailed = true;
+  }
+  return 0;
+}
+
 static tainted<int, TestType> exampleCallback2( // NOLINT(google-runtime-int)
   rlbox_sandbox<TestType>& /* sandbox */,
   tainted<unsigned long, TestType> val1, // NOLINT(google-runtime-int)
@@ -162,6 +190,68 @@ TEST_CASE("sandbox glue tests " TestName, "[sandbox_glue_tests]")
     REQUIRE(ret2.UNSAFE_unverified() == (val1 + val2));
   }
 
+  SECTION("test pre-resolved function invocation") // NOLINT
+  {
+    rlbox::sandbox_function<decltype(simpleAddNoPrintTest), TestType> empty;
+    REQUIRE(empty.is_unresolved());
+
+    auto fn = sandbox.get_sandbox_function(simpleAddNoPrintTest);
+    REQUIRE(!fn.is_unresolved());
+
+    const long val1 = 20;
+    const long val2 = 22;
+    tainted<long, TestType> a = val1;
+    auto ret2 = fn(a, val2);
+    REQUIRE(ret2.UNSAFE_unverified() == (val1 + val2));
+
+    auto fnCopy = fn;
+    auto ret3 = fnCopy(val2, val2);
+    REQUIRE(ret3.UNSAFE_unverified() == (val2 + val2));
+  }
+
+  SECTION("test function prebinding") // NOLINT
+  {
+    sandbox.prebind_sandbox_functions(simpleAddNoPrintTest, simpleAddTest);
+    sandbox.prebind_symbols({ "simpleAddNoPrintTest", "echoPointer" });
+
+    const long val1 = 20;
+    const long val2 = 22;
+    auto ret2 = sandbox.invoke_sandbox_function(simpleAddNoPrintTest, val1, val2);
+    REQUIRE(ret2.UNSAFE_unverified() == (val1 + val2));
+  }
+
+  SECTION("test batched function invocation") // NOLINT
+  {
+    const long val1 = 20;
+    const long val2 = 22;
+    const int val3 = 7;
+    tainted<long, TestType> a = val1;
+    tainted<int*, TestType> p = sandbox.template malloc_in_sandbox<int>();
+    auto fn = sandbox.get_sandbox_function(simpleAddNoPrintTest);
+    auto [ret1, ret2, ret3] = sandbox.invoke_sandbox_batch(
+      sandbox.bind_sandbox_function(simpleAddNoPrintTest, a, val2),
+      sandbox.bind_sandbox_function(simplePointerWrite, p, val3),
+      fn.bind(val2, val2));
+    REQUIRE(ret1.UNSAFE_unverified() == (val1 + val2));
+    REQUIRE(std::is_same_v<decltype(ret2), std::monostate>);
+    REQUIRE(ret3.UNSAFE_unverified() == (val2 + val2));
+    REQUIRE((*p).UNSAFE_unverified() == val3);
+    sandbox.free_in_sandbox(p);
+  }
+
+  SECTION("test async function invocation") // NOLINT
+  {
+    const long val1 = 20;
+    const long val2 = 22;
+    tainted<long, TestType> a = val1;
+    auto future1 =
+      sandbox.invoke_sandbox_function_async(simpleAddNoPrintTest, a, val2);
+    auto future2 = sandbox.get_sandbox_function(simpleAddNoPrintTest)
+                     .invoke_async(val2, val2);
+    REQUIRE(future1.get().UNSAFE_unverified() == (val1 + val2));
+    REQUIRE(future2.get().UNSAFE_unverified() == (val2 + val2));
+  }
+
   SECTION("test simple function invocation with print") // NOLINT
   {
     const int val1 = 20;
@@ -576,6 +666,201 @@ TEST_CASE("sandbox glue tests " TestName, "[sandbox_glue_tests]")
     sandbox.free_in_sandbox(initVal);
   }
 
+  SECTION("Struct conversion measurements") // NOLINT
+  {
+    auto pTest = sandbox.template malloc_in_sandbox<testStruct>();
+    *pTest = tainted<testStruct, TestType>{};
+    auto initVal = sandbox.template malloc_in_sandbox<char>(upper_bound);
+    auto pPointers =
+      sandbox.invoke_sandbox_function(initializePointerStructPtr, initVal);
+
+    // Copy each struct out of the sandbox and back in
+    uint64_t result1 = 0;
+    {
+      auto enter_time = high_resolution_clock::now();
+      for (int i = 0; i < TEST_ITERATIONS; i++) {
+        tainted<testStruct, TestType> val = *pTest;
+        val.fieldLong = val.fieldLong.UNSAFE_unverified() + 1;
+        *pTest = val;
+        result1 += val.fieldBool.UNSAFE_unverified();
+      }
+      auto exit_time = high_resolution_clock::now();
+
+      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      std::cout << "testStruct conversion time: " << (ns / TEST_ITERATIONS)
+                << "\n";
+    }
+
+    uint64_t result2 = 0;
+    {
+      auto enter_time = high_resolution_clock::now();
+      for (int i = 0; i < TEST_ITERATIONS; i++) {
+        tainted<pointersStruct, TestType> val = *pPointers;
+        *pPointers = val;
+        result2 += val.lastPointer.UNSAFE_unverified() != nullptr;
+      }
+      auto exit_time = high_resolution_clock::now();
+
+      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      std::cout << "pointersStruct conversion time: " << (ns / TEST_ITERATIONS)
+                << "\n";
+    }
+
+    REQUIRE(pTest->fieldLong.UNSAFE_unverified() ==
+            static_cast<unsigned long>(TEST_ITERATIONS));
+    REQUIRE(result1 == 0);
+    REQUIRE(result2 == static_cast<uint64_t>(TEST_ITERATIONS));
+
+    sandbox.free_in_sandbox(pPointers);
+    sandbox.free_in_sandbox(initVal);
+    sandbox.free_in_sandbox(pTest);
+  }
+
+  SECTION("Range copy measurements") // NOLINT
+  {
+    const uint32_t size = 4 * 1024 * 1024;
+    const int copies = 16;
+    auto pBuffer = sandbox.template malloc_in_sandbox<char>(size);
+    std::memset(pBuffer.UNSAFE_unverified(), 'a', size);
+
+    uint64_t result = 0;
+    auto enter_time = high_resolution_clock::now();
+    for (int i = 0; i < copies; i++) {
+      result += pBuffer.copy_and_verify_range(
+        [](std::unique_ptr<char[]> val) { // NOLINT
+          return val[size - 1];
+        },
+        size);
+    }
+    auto exit_time = high_resolution_clock::now();
+
+    int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "copy_and_verify_range throughput (MB/s): "
+              << (uint64_t(size) * copies * 1000 / (ns + 1)) << "\n";
+
+    REQUIRE(result == uint64_t('a') * copies);
+    sandbox.free_in_sandbox(pBuffer);
+  }
+
+  SECTION("String copy measurements") // NOLINT
+  {
+    // Larger than the small string buffer of std::string
+    const uint32_t sizes[] = { 64, 4096 };
+    for (auto size : sizes) {
+      auto pString = sandbox.template malloc_in_sandbox<char>(size);
+      std::memset(pString.UNSAFE_unverified(), 'a', size - 1);
+      pString[size - 1] = '\0';
+
+      uint64_t result = 0;
+      const int copies = TEST_ITERATIONS / 10;
+      auto enter_time = high_resolution_clock::now();
+      for (int i = 0; i < copies; i++) {
+        result += pString.copy_and_verify_string(
+          [](std::string val) { return val.size(); });
+      }
+      auto exit_time = high_resolution_clock::now();
+
+      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      std::cout << "copy_and_verify_string time for " << size
+                << " bytes: " << (ns / copies) << "\n";
+
+      // Reusing a buffer rather than allocating for each copy
+      std::vector<char> buffer(size);
+      enter_time = high_resolution_clock::now();
+      for (int i = 0; i < copies; i++) {
+        result += pString.copy_and_verify_string_into(
+          [&](char* val) { return val != nullptr ? size - 1 : 0; },
+          buffer.data(),
+          buffer.size());
+      }
+      exit_time = high_resolution_clock::now();
+
+      ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      std::cout << "copy_and_verify_string_into time for " << size
+                << " bytes: " << (ns / copies) << "\n";
+
+      // Copying into an arena that is reset after each request
+      rlbox::verify_arena arena;
+      enter_time = high_resolution_clock::now();
+      for (int i = 0; i < copies; i++) {
+        result += pString.copy_and_verify_string(
+          [](char* val) { return std::strlen(val); }, arena);
+        arena.reset();
+      }
+      exit_time = high_resolution_clock::now();
+
+      ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      std::cout << "copy_and_verify_string arena time for " << size
+                << " bytes: " << (ns / copies) << "\n";
+
+      REQUIRE(result == uint64_t(size - 1) * copies * 3);
+      sandbox.free_in_sandbox(pString);
+    }
+  }
+
+  SECTION("Small allocation measurements") // NOLINT
+  {
+    const int allocs = TEST_ITERATIONS / 10;
+    uint64_t result = 0;
+
+    auto enter_time = high_resolution_clock::now();
+    for (int i = 0; i < allocs; i++) {
+      auto pStruct = sandbox.template malloc_in_sandbox<testStruct>();
+      auto pOut = sandbox.template malloc_in_sandbox<unsigned>();
+      result += (pStruct != nullptr) + (pOut != nullptr);
+      sandbox.free_in_sandbox(pOut);
+      sandbox.free_in_sandbox(pStruct);
+    }
+    auto exit_time = high_resolution_clock::now();
+
+    int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "malloc_in_sandbox time for a struct and an int: "
+              << (ns / allocs) << "\n";
+
+    enter_time = high_resolution_clock::now();
+    for (int i = 0; i < allocs; i++) {
+      auto ptrs =
+        sandbox.template malloc_in_sandbox_batch<testStruct, unsigned>(1, 1);
+      result += (std::get<0>(ptrs) != nullptr) + (std::get<1>(ptrs) != nullptr);
+      sandbox.free_in_sandbox_batch(ptrs);
+    }
+    exit_time = high_resolution_clock::now();
+
+    ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "malloc_in_sandbox_batch time for a struct and an int: "
+              << (ns / allocs) << "\n";
+
+    rlbox::sandbox_slab_allocator<TestType> slab(sandbox);
+    enter_time = high_resolution_clock::now();
+    for (int i = 0; i < allocs; i++) {
+      auto pStruct = slab.template malloc_in_sandbox<testStruct>();
+      auto pOut = slab.template malloc_in_sandbox<unsigned>();
+      result += (pStruct != nullptr) + (pOut != nullptr);
+      slab.free_in_sandbox(pOut);
+      slab.free_in_sandbox(pStruct);
+    }
+    exit_time = high_resolution_clock::now();
+
+    ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "sandbox_slab_allocator time for a struct and an int: "
+              << (ns / allocs) << "\n";
+
+    enter_time = high_resolution_clock::now();
+    for (int i = 0; i < allocs; i++) {
+      rlbox::sandbox_frame<TestType> frame(sandbox);
+      auto pStruct = frame.template malloc_in_sandbox<testStruct>();
+      auto pOut = frame.template malloc_in_sandbox<unsigned>();
+      result += (pStruct != nullptr) + (pOut != nullptr);
+    }
+    exit_time = high_resolution_clock::now();
+
+    ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+    std::cout << "sandbox_frame time for a struct and an int: "
+              << (ns / allocs) << "\n";
+
+    REQUIRE(result == uint64_t(allocs) * 8);
+  }
+
   SECTION("Function invocation measurements") // NOLINT
   {
     // Warm up the timer. The first call is always slow (at least on the test
@@ -622,7 +907,89 @@ TEST_CASE("sandbox glue tests " TestName, "[sandbox_glue_tests]")
                 << (ns / TEST_ITERATIONS) << "\n";
     }
 
+    // Sandbox with a pre-resolved function handle
+    uint64_t result3 = 0;
+    {
+      auto fn = sandbox.get_sandbox_function(simpleAddNoPrintTest);
+      auto enter_time = high_resolution_clock::now();
+      for (int i = 0; i < TEST_ITERATIONS; i++) {
+        // to make sure the optimizer doesn't try to be too clever and eliminate
+        // the call
+        result3 += fn(val1, val2).unverified_safe_because("test");
+      }
+      auto exit_time = high_resolution_clock::now();
+
+      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      std::cout << "Sandboxed function handle invocation time: "
+                << (ns / TEST_ITERATIONS) << "\n";
+    }
+
+    // Sandbox with batches of function calls
+    uint64_t result4 = 0;
+    {
+      const int batch_size = 10;
+      auto call = sandbox.bind_sandbox_function(simpleAddNoPrintTest, val1, val2);
+      auto enter_time = high_resolution_clock::now();
+      for (int i = 0; i < TEST_ITERATIONS / batch_size; i++) {
+        // to make sure the optimizer doesn't try to be too clever and eliminate
+        // the call
+        std::apply(
+          [&](auto&&... results) {
+            ((result4 += results.unverified_safe_because("test")), ...);
+          },
+          sandbox.invoke_sandbox_batch(
+            call, call, call, call, call, call, call, call, call, call));
+      }
+      auto exit_time = high_resolution_clock::now();
+
+      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      std::cout << "Sandboxed batched function invocation time: "
+                << (ns / TEST_ITERATIONS) << "\n";
+    }
+
     REQUIRE(result1 == result2);
+    REQUIRE(result1 == result3);
+    REQUIRE(result1 == result4);
+  }
+
+  SECTION("Multi-threaded function invocation measurements") // NOLINT
+  {
+    const int val1 = 2;
+    const int val2 = 3;
+    const uint64_t expected = val1 + val2;
+
+    for (int thread_count = 1; thread_count <= 4; thread_count *= 2) {
+      const int iterations = TEST_ITERATIONS / thread_count;
+      std::vector<uint64_t> results(thread_count, 0);
+      std::vector<std::thread> threads;
+
+      auto enter_time = high_resolution_clock::now();
+      for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+          uint64_t result = 0;
+          for (int i = 0; i < iterations; i++) {
+            result +=
+              sandbox.invoke_sandbox_function(simpleAddNoPrintTest, val1, val2)
+                .unverified_safe_because("test");
+          }
+          results[t] = result;
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      auto exit_time = high_resolution_clock::now();
+
+      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      uint64_t total_calls = static_cast<uint64_t>(iterations) * thread_count;
+      std::cout << "Sandboxed function invocation throughput with "
+                << thread_count << " threads: "
+                << (ns > 0 ? total_calls * 1000000 / ns : 0) << " calls/ms\n";
+
+      for (auto result : results) {
+        REQUIRE(result == expected * iterations);
+      }
+    }
   }
 
   SECTION("test grant deny access") // NOLINT
@@ -699,6 +1066,34 @@ TEST_CASE("sandbox glue tests callbacks " TestName, "[sandbox_glue_tests]")
     REQUIRE(result == 11);
   }
 
+  SECTION("test callback from async invocation") // NOLINT
+  {
+    auto cb_callback_param = sandbox.register_callback(exampleCallback2);
+
+    auto resultT =
+      sandbox
+        .invoke_sandbox_function_async(simpleCallbackTest2, 4, cb_callback_param)
+        .get();
+
+    auto result = resultT.copy_and_verify([](int val) { return val; });
+    REQUIRE(result == 11);
+  }
+
+  SECTION("test destroying a sandbox from its async invocation") // NOLINT
+  {
+    auto cb_callback_param = sandbox.register_callback(destroyingCallback);
+
+    destroyFromAsyncFailed = false;
+    sandbox
+      .invoke_sandbox_function_async(simpleCallbackTest2, 4, cb_callback_param)
+      .get();
+    REQUIRE(destroyFromAsyncFailed);
+
+    // The sandbox is still usable
+    auto resultT = sandbox.invoke_sandbox_function(simpleAddNoPrintTest, 2, 3);
+    REQUIRE(resultT.UNSAFE_unverified() == 5);
+  }
+
   SECTION("test callback different returns") // NOLINT
   {
     {
@@ -771,6 +1166,38 @@ TEST_CASE("sandbox glue tests callbacks " TestName, "[sandbox_glue_tests]")
     }
   }
 
+  SECTION("test bulk callback registration") // NOLINT
+  {
+    {
+      auto [cb2, cb3] =
+        sandbox.register_callbacks(exampleCallback2, exampleCallback3);
+
+      auto result2T =
+        sandbox.invoke_sandbox_function(simpleCallbackTest2, 4, cb2);
+      REQUIRE(result2T.copy_and_verify([](int val) { return val; }) == 11);
+
+      const int val1 = 2;
+      const int val2 = 3;
+      const unsigned long iterations = 3; // NOLINT(google-runtime-int)
+      auto result3T = sandbox.invoke_sandbox_function(
+        simpleCallbackLoop, val1, val2, iterations, cb3);
+      REQUIRE(result3T.unverified_safe_because("test") ==
+              (val1 + val2) * iterations);
+
+      // If any callback is already registered, none are registered
+      REQUIRE_THROWS(
+        sandbox.register_callbacks(exampleCallback, exampleCallback2));
+      REQUIRE_THROWS(
+        sandbox.register_callbacks(exampleCallback, exampleCallback));
+    }
+
+    auto [cb1, cb2, cb3] = sandbox.register_callbacks(
+      exampleCallback, exampleCallback2, exampleCallback3);
+    REQUIRE(!cb1.is_unregistered());
+    REQUIRE(!cb2.is_unregistered());
+    REQUIRE(!cb3.is_unregistered());
+  }
+
   SECTION("Callback invocation measurements") // NOLINT
   {
     auto cb_callback_param = sandbox.register_callback(exampleCallback3);
@@ -808,6 +1235,49 @@ TEST_CASE("sandbox glue tests callbacks " TestName, "[sandbox_glue_tests]")
     REQUIRE(result1 == result2);
   }
 
+  SECTION("Multi-threaded callback invocation measurements") // NOLINT
+  {
+    auto cb_callback_param = sandbox.register_callback(exampleCallback3);
+
+    const int val1 = 2;
+    const int val2 = 3;
+    const uint64_t expected = static_cast<uint64_t>(val1 + val2) *
+                              static_cast<uint64_t>(TEST_ITERATIONS / 4);
+
+    for (int thread_count = 1; thread_count <= 4; thread_count *= 2) {
+      const int iterations = TEST_ITERATIONS / 4;
+      std::vector<uint64_t> results(thread_count, 0);
+      std::vector<std::thread> threads;
+
+      auto enter_time = high_resolution_clock::now();
+      for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+          results[t] = sandbox
+                         .invoke_sandbox_function(simpleCallbackLoop,
+                                                  val1,
+                                                  val2,
+                                                  iterations,
+                                                  cb_callback_param)
+                         .unverified_safe_because("test");
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      auto exit_time = high_resolution_clock::now();
+
+      int64_t ns = duration_cast<nanoseconds>(exit_time - enter_time).count();
+      uint64_t total_calls = static_cast<uint64_t>(iterations) * thread_count;
+      std::cout << "Sandboxed callback invocation throughput with "
+                << thread_count << " threads: "
+                << (ns > 0 ? total_calls * 1000000 / ns : 0) << " calls/ms\n";
+
+      for (auto result : results) {
+        REQUIRE(result == expected);
+      }
+    }
+  }
+
   sandbox.free_in_sandbox(sb_string);
 
   sandbox.destroy_sandbox();